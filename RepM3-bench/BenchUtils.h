@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+namespace bench {
+
+  // allocation counters, updated by replaced global operator new in main.cpp
+  struct AllocCounter {
+    static std::atomic<uint64_t> & count() {
+      static std::atomic<uint64_t> c(0);
+      return c;
+    }
+
+    static std::atomic<uint64_t> & bytes() {
+      static std::atomic<uint64_t> b(0);
+      return b;
+    }
+  };
+
+  // prevent compiler from optimizing out computed value
+  template <typename T>
+  inline void doNotOptimize(const T & val) {
+#ifdef __GNUC__
+    asm volatile("" : : "r,m"(val) : "memory");
+#else
+    static volatile const T * sink;
+    sink = &val;
+#endif
+  }
+
+  struct Result {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+    // processed input per op, used for MB/s
+    uint64_t processed_per_op;
+  };
+
+  // benchmark body runs given number of iterations
+  typedef std::function<void(uint64_t iterations)> BenchFn;
+
+  // format of results written by Runner::write
+  enum Format {
+    FORMAT_TABLE,
+    FORMAT_JSON,
+    FORMAT_CSV,
+  };
+
+  // n operations split to given number of threads, fn gets the operation index
+  template <typename Fn>
+  void runThreads(unsigned threads, uint64_t n, Fn fn) {
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+      workers.emplace_back([=]() {
+        for (uint64_t i = t; i < n; i += threads) {
+          fn(i);
+        }
+      });
+    }
+    for (auto & w : workers) {
+      w.join();
+    }
+  }
+
+  class Runner {
+    public:
+      explicit Runner(double min_time_ms = 200)
+      : m_min_time_ms(min_time_ms), m_log(stdout) {}
+
+      // progress table goes to stdout by default
+      void setLog(FILE * log) {
+        m_log = log;
+      }
+
+      void add(const std::string & name, BenchFn fn, uint64_t processed_per_op = 0) {
+        m_benches.push_back(Bench{name, fn, processed_per_op});
+      }
+
+      // run benchmarks whose name contains filter
+      void run(const std::string & filter = std::string()) {
+        fprintf(m_log, "%-48s %12s %12s %10s %10s %10s\n", "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op", "MB/s");
+        for (auto & b : m_benches) {
+          if (!filter.empty() && b.name.find(filter) == std::string::npos) {
+            continue;
+          }
+          Result r = measure(b);
+          print(m_log, r);
+          fflush(m_log);
+          m_results.push_back(r);
+        }
+      }
+
+      // write all results in machine-readable format to compare them across releases
+      void write(FILE * out, Format format) const {
+        if (format == FORMAT_JSON) {
+          fprintf(out, "{\n  \"benchmarks\": [");
+          for (size_t i = 0; i < m_results.size(); i++) {
+            const Result & r = m_results[i];
+            fprintf(out, "%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.3f, \"mb_per_s\": %.3f}",
+              i ? "," : "", r.name.c_str(), (unsigned long long)r.iterations, r.ns_per_op, r.allocs_per_op, r.bytes_per_op, mbPerSecond(r));
+          }
+          fprintf(out, "\n  ]\n}\n");
+        } else if (format == FORMAT_CSV) {
+          fprintf(out, "name,iterations,ns_per_op,allocs_per_op,bytes_per_op,mb_per_s\n");
+          for (const Result & r : m_results) {
+            fprintf(out, "%s,%llu,%.3f,%.3f,%.3f,%.3f\n", r.name.c_str(), (unsigned long long)r.iterations,
+              r.ns_per_op, r.allocs_per_op, r.bytes_per_op, mbPerSecond(r));
+          }
+        } else {
+          for (const Result & r : m_results) {
+            print(out, r);
+          }
+        }
+      }
+
+      const std::vector<Result> & results() const {
+        return m_results;
+      }
+
+    private:
+      struct Bench {
+        std::string name;
+        BenchFn fn;
+        uint64_t processed_per_op;
+      };
+
+      Result measure(Bench & b) {
+        typedef std::chrono::steady_clock clock;
+        // warm up and find number of iterations filling the minimal time
+        uint64_t iterations = 1;
+        double elapsed_ms = 0;
+        uint64_t allocs = 0;
+        uint64_t bytes = 0;
+        while (true) {
+          uint64_t a0 = AllocCounter::count().load();
+          uint64_t b0 = AllocCounter::bytes().load();
+          auto start = clock::now();
+          b.fn(iterations);
+          auto stop = clock::now();
+          allocs = AllocCounter::count().load() - a0;
+          bytes = AllocCounter::bytes().load() - b0;
+          elapsed_ms = std::chrono::duration<double, std::milli>(stop - start).count();
+          if (elapsed_ms >= m_min_time_ms || iterations >= (1ull << 40)) {
+            break;
+          }
+          iterations *= (elapsed_ms < m_min_time_ms / 10) ? 10 : 2;
+        }
+
+        Result r;
+        r.name = b.name;
+        r.iterations = iterations;
+        r.ns_per_op = elapsed_ms * 1e6 / iterations;
+        r.allocs_per_op = double(allocs) / iterations;
+        r.bytes_per_op = double(bytes) / iterations;
+        r.processed_per_op = b.processed_per_op;
+        return r;
+      }
+
+      static double mbPerSecond(const Result & r) {
+        return r.processed_per_op ? (r.processed_per_op * 1e3 / r.ns_per_op) : 0;
+      }
+
+      static void print(FILE * out, const Result & r) {
+        fprintf(out, "%-48s %12llu %12.1f %10.2f %10.1f %10.1f\n", r.name.c_str(), (unsigned long long)r.iterations,
+          r.ns_per_op, r.allocs_per_op, r.bytes_per_op, mbPerSecond(r));
+      }
+
+    private:
+      double m_min_time_ms;
+      FILE * m_log;
+      std::vector<Bench> m_benches;
+      std::vector<Result> m_results;
+  };
+}
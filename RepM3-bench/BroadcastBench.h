@@ -0,0 +1,75 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3_broadcast.h"
+
+#include <memory>
+
+namespace bench {
+
+  // every sent frame is acknowledged immediately by empty response of the same command
+  class AckTransport : public lgmc::Transport {
+    public:
+      explicit AckTransport(uint8_t id) {
+        m_ack.resize(lgmc::FrameCodec::encode(m_ack.data(), m_ack.size(), id, nullptr, 0));
+      }
+
+      bool send(lgmc::NodeAddr node, const uint8_t *data, size_t size) override {
+        doNotOptimize(data[size - 1]);
+        m_queue.push_back(node);
+        return true;
+      }
+
+      size_t receive(Receiver &receiver, std::chrono::microseconds) override {
+        for (lgmc::NodeAddr node : m_queue) {
+          receiver.onFrame(node, m_ack.data(), m_ack.size());
+        }
+        size_t n = m_queue.size();
+        m_queue.clear();
+        return n;
+      }
+
+    private:
+      std::vector<uint8_t> m_ack = std::vector<uint8_t>(16);
+      std::vector<lgmc::NodeAddr> m_queue;
+  };
+
+  // fleet-wide ResetFlags: command object and frame per node vs frame encoded once with ack bitmap
+  void registerBroadcastBenchmarks(Runner & runner) {
+    using namespace lgmc;
+    const size_t nodes = 10000;
+
+    runner.add("broadcast/per_node/10k", [nodes](uint64_t n) {
+      AckTransport transport(CMD_RESET_FLAGS);
+      std::vector<bool> acked(nodes);
+      for (uint64_t i = 0; i < n; i++) {
+        for (NodeAddr node = 0; node < nodes; node++) {
+          ResetFlagsCmd cmd;
+          std::vector<uint8_t> frame = cmd.serialize();
+          transport.send(node, frame.data(), frame.size());
+        }
+        struct Acks : Transport::Receiver {
+          std::vector<bool> *acked;
+          void onFrame(NodeAddr node, const uint8_t *data, size_t size) override {
+            (*acked)[node] = FrameView(data, size).isValid();
+          }
+        } acks;
+        acks.acked = &acked;
+        transport.receive(acks, std::chrono::microseconds(0));
+        doNotOptimize(acked);
+      }
+    });
+
+    runner.add("broadcast/once/10k", [nodes](uint64_t n) {
+      AckTransport transport(CMD_RESET_FLAGS);
+      Broadcast broadcast(transport);
+      for (NodeAddr node = 0; node < nodes; node++) {
+        broadcast.addNode(node);
+      }
+      for (uint64_t i = 0; i < n; i++) {
+        broadcast.setCommand<ResetFlagsCmd>();
+        doNotOptimize(broadcast.run());
+      }
+    });
+  }
+}
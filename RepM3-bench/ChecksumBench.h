@@ -0,0 +1,88 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3.h"
+
+namespace bench {
+
+  // helpers as they were in BaseCommand before fused checksums, kept for comparison
+  namespace legacy {
+    uint8_t crc(const std::vector<uint8_t> &data) {
+      uint32_t val = 0;
+      for (auto x : data) {
+        val += x;
+      }
+      return val % 256;
+    }
+
+    std::vector<uint8_t> computeSecurityBytes(uint8_t id, int len, std::vector<uint8_t> d = std::vector<uint8_t>()) {
+      std::vector<uint8_t> ret{9, 227, 0, id};
+      uint32_t val = 0;
+      uint8_t lenb = 0xFF & len;
+      val += 0xFF & (~(lenb + 1));
+      val += 0xFF & (~(id + 1));
+      for (auto x : d) {
+        val += 0xFF & (~(x + 1));
+      }
+      ret[2] = val % 256;
+      return ret;
+    }
+  }
+
+  void registerChecksumBenchmarks(Runner & runner) {
+    using namespace lgmc;
+
+    // GetReport index, long report, settings page and maximal payload
+    for (size_t size : {1, 30, 31, 250}) {
+      std::vector<uint8_t> payload(size);
+      for (size_t i = 0; i < size; i++) {
+        payload[i] = uint8_t(i * 7);
+      }
+      std::string suffix = "/" + std::to_string(size) + "B";
+      uint8_t len = uint8_t(size + 1 + 4);
+
+      runner.add("checksum/legacy" + suffix, [payload, len](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+          std::vector<uint8_t> security = legacy::computeSecurityBytes(15, len, payload);
+          std::vector<uint8_t> c{len, 15};
+          c.insert(c.end(), security.begin(), security.end());
+          c.insert(c.end(), payload.begin(), payload.end());
+          uint8_t crc = legacy::crc(c);
+          doNotOptimize(crc);
+        }
+      }, size);
+
+      runner.add("checksum/fused" + suffix, [payload, len](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+          doNotOptimize(payload.data());
+          FrameCodec::Checksums c = FrameCodec::checksums(len, 15, payload.data(), payload.size(), true);
+          doNotOptimize(c);
+        }
+      }, size);
+    }
+
+    // verify batch of 1024 long report responses
+    std::shared_ptr<std::vector<uint8_t>> arena = std::make_shared<std::vector<uint8_t>>();
+    const size_t frame_size = GetReportLongCmd::impl_type::response_size;
+    const size_t count = 1024;
+    arena->resize(frame_size * count);
+    GetReportLongCmd::data_t_long report;
+    std::memset(static_cast<void *>(&report), 0x3C, sizeof(report));
+    for (size_t i = 0; i < count; i++) {
+      FrameCodec::encode(&(*arena)[i * frame_size], frame_size, CMD_GET_REPORT, &report, sizeof(report));
+    }
+
+    runner.add("checksum/verify/batch1024", [arena, frame_size, count](uint64_t n) {
+      std::vector<const uint8_t *> frames(count);
+      std::vector<size_t> sizes(count, frame_size);
+      std::vector<FrameStatus> results(count);
+      for (size_t i = 0; i < count; i++) {
+        frames[i] = &(*arena)[i * frame_size];
+      }
+      for (uint64_t i = 0; i < n; i++) {
+        size_t valid = FrameCodec::verify(frames.data(), sizes.data(), count, results.data());
+        doNotOptimize(valid);
+      }
+    }, arena->size());
+  }
+}
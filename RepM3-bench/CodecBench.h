@@ -0,0 +1,219 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3.h"
+#include "repM3_batch.h"
+
+#include <memory>
+
+namespace bench {
+
+  void registerCodecBenchmarks(Runner & runner) {
+    using namespace lgmc;
+
+    runner.add("encode/GetFlags/vector", [](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        GetFlagsCmd cmd;
+        std::vector<uint8_t> frame = cmd.serialize();
+        doNotOptimize(frame);
+      }
+    });
+
+    runner.add("encode/GetFlags/buffer", [](uint64_t n) {
+      GetFlagsCmd cmd;
+      uint8_t buf[16];
+      for (uint64_t i = 0; i < n; i++) {
+        size_t size = cmd.serialize(buf, sizeof(buf));
+        doNotOptimize(size);
+        doNotOptimize(buf);
+      }
+    });
+
+    runner.add("encode/GetReportLong/vector", [](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        GetReportLongCmd cmd;
+        std::vector<uint8_t> frame = cmd.serialize();
+        doNotOptimize(frame);
+      }
+    });
+
+    runner.add("encode/GetReportLong/buffer", [](uint64_t n) {
+      GetReportLongCmd cmd;
+      std::array<uint8_t, 16> buf;
+      for (uint64_t i = 0; i < n; i++) {
+        size_t size = cmd.serialize(buf.data(), buf.size());
+        doNotOptimize(size);
+        doNotOptimize(buf);
+      }
+    });
+
+    // payload changes every iteration so the frame can't be hoisted out of the loop
+    runner.add("encode/GetReport/index/buffer", [](uint64_t n) {
+      Impl<GetReportCmd::data_send_t, GetReportLongCmd::data_t_long, CMD_GET_REPORT> impl;
+      GetReportCmd::data_send_t idx;
+      std::array<uint8_t, 16> buf;
+      for (uint64_t i = 0; i < n; i++) {
+        idx.report_index = uint8_t(i & 0x3F) + 128;
+        size_t size = impl.serialize(idx, buf.data(), buf.size());
+        doNotOptimize(size);
+        doNotOptimize(buf);
+      }
+    });
+
+    runner.add("encode/GetSettings/security/vector", [](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        GetSettingsCmd cmd;
+        cmd.setPage(0);
+        std::vector<uint8_t> frame = cmd.serialize();
+        doNotOptimize(frame);
+      }
+    });
+
+    runner.add("encode/GetSettings/security/buffer", [](uint64_t n) {
+      GetSettingsCmd cmd;
+      cmd.setPage(0);
+      uint8_t buf[16];
+      for (uint64_t i = 0; i < n; i++) {
+        size_t size = cmd.serialize(buf, sizeof(buf));
+        doNotOptimize(size);
+        doNotOptimize(buf);
+      }
+    });
+
+    runner.add("decode/GetVersion/vector", [](uint64_t n) {
+      std::vector<uint8_t> frame{0xB1, 0x5, 0x9, 0x5, 0x1, 0x2, 0x0, 0x16, 0xB2};
+      for (uint64_t i = 0; i < n; i++) {
+        GetVersionCmd cmd;
+        cmd.deserialize(frame);
+        doNotOptimize(cmd.getData());
+      }
+    });
+
+    runner.add("decode/GetVersion/buffer", [](uint64_t n) {
+      uint8_t frame[] = {0xB1, 0x5, 0x9, 0x5, 0x1, 0x2, 0x0, 0x16, 0xB2};
+      GetVersionCmd cmd;
+      for (uint64_t i = 0; i < n; i++) {
+        cmd.deserialize(frame, sizeof(frame));
+        doNotOptimize(cmd.getData());
+      }
+    });
+
+    runner.add("decode/GetVersion/view", [](uint64_t n) {
+      uint8_t frame[] = {0xB1, 0x5, 0x9, 0x5, 0x1, 0x2, 0x0, 0x16, 0xB2};
+      typedef Impl<none, GetVersionCmd::data_t, CMD_GET_VERSION> impl_t;
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(frame);
+        const GetVersionCmd::data_t *d = impl_t::payload(FrameView(frame, sizeof(frame)));
+        doNotOptimize(d);
+      }
+    });
+
+    // response frames of 1000 nodes decoded by command object per frame vs stateless codec
+    std::shared_ptr<std::vector<uint8_t>> responses = std::make_shared<std::vector<uint8_t>>(1000 * Codec<GetFlagsCmd>::response_size);
+    for (size_t i = 0; i < 1000; i++) {
+      GetFlagsCmd::data_t flags{};
+      flags.error_flags.data = uint16_t(i);
+      FrameCodec::encode(&(*responses)[i * Codec<GetFlagsCmd>::response_size], Codec<GetFlagsCmd>::response_size, CMD_GET_FLAGS, &flags, sizeof(flags));
+    }
+
+    runner.add("decode/GetFlags/object", [responses](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        GetFlagsCmd cmd;
+        cmd.deserialize(&(*responses)[i % 1000 * Codec<GetFlagsCmd>::response_size], Codec<GetFlagsCmd>::response_size);
+        doNotOptimize(cmd.getData());
+      }
+    }, Codec<GetFlagsCmd>::response_size);
+
+    runner.add("decode/GetFlags/codec", [responses](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        GetFlagsCmd::data_t flags{};
+        doNotOptimize(Codec<GetFlagsCmd>::decode(&(*responses)[i % 1000 * Codec<GetFlagsCmd>::response_size], Codec<GetFlagsCmd>::response_size, flags));
+        doNotOptimize(flags);
+      }
+    }, Codec<GetFlagsCmd>::response_size);
+
+    runner.add("decode/GetFlags/codec/4threads", [responses](uint64_t n) {
+      runThreads(4, n, [responses](uint64_t i) {
+        GetFlagsCmd::data_t flags{};
+        doNotOptimize(Codec<GetFlagsCmd>::decode(&(*responses)[i % 1000 * Codec<GetFlagsCmd>::response_size], Codec<GetFlagsCmd>::response_size, flags));
+        doNotOptimize(flags);
+      });
+    }, Codec<GetFlagsCmd>::response_size);
+
+    runner.add("decode/GetVersion/badCrc/throw", [](uint64_t n) {
+      uint8_t frame[] = {0xB1, 0x5, 0x9, 0x5, 0x1, 0x2, 0x0, 0x17, 0xB2};
+      GetVersionCmd cmd;
+      for (uint64_t i = 0; i < n; i++) {
+        try {
+          cmd.deserialize(frame, sizeof(frame));
+        } catch (std::logic_error & e) {
+          doNotOptimize(e);
+        }
+      }
+    });
+
+    runner.add("decode/GetVersion/badCrc/status", [](uint64_t n) {
+      uint8_t frame[] = {0xB1, 0x5, 0x9, 0x5, 0x1, 0x2, 0x0, 0x17, 0xB2};
+      GetVersionCmd cmd;
+      FrameStats stats;
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(frame);
+        stats.add(cmd.tryDeserialize(frame, sizeof(frame)));
+      }
+      doNotOptimize(stats);
+    });
+
+    runner.add("encode/GetFlags/constexpr", [](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        constexpr GetFlagsCmd::impl_type::frame_type frame = GetFlagsCmd::impl_type::requestFrame();
+        std::array<uint8_t, GetFlagsCmd::impl_type::frame_size> buf = frame;
+        doNotOptimize(buf);
+      }
+    });
+
+    runner.add("encode/GetReport/index/array", [](uint64_t n) {
+      GetReportCmd::data_send_t idx;
+      for (uint64_t i = 0; i < n; i++) {
+        idx.report_index = uint8_t(i & 0x3F) + 128;
+        GetReportLongCmd::impl_type::frame_type frame = GetReportLongCmd::impl_type::encode(idx);
+        doNotOptimize(frame);
+      }
+    });
+
+    // poll cycle of 1000 nodes, GetFlags, GetReport and GetSettings for each node
+    const size_t nodes = 1000;
+
+    runner.add("batch/pollCycle1000/vectors", [nodes](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        std::vector<std::vector<uint8_t>> frames;
+        for (size_t node = 0; node < nodes; node++) {
+          GetFlagsCmd flags;
+          frames.push_back(flags.serialize());
+          GetReportLongCmd report;
+          frames.push_back(report.serialize());
+          GetSettingsCmd settings;
+          settings.setPage(0);
+          frames.push_back(settings.serialize());
+        }
+        doNotOptimize(frames);
+      }
+    });
+
+    runner.add("batch/pollCycle1000/arena", [nodes](uint64_t n) {
+      RequestBatch batch(3 * nodes);
+      GetReportCmd::data_send_t idx;
+      idx.report_index = 128;
+      GetSettingsCmd::data_send_t page;
+      page.system_settings_page = 0;
+      for (uint64_t i = 0; i < n; i++) {
+        batch.clear();
+        for (size_t node = 0; node < nodes; node++) {
+          batch.addRequest<GetFlagsCmd>(NodeAddr(node));
+          batch.addRequest<GetReportLongCmd>(NodeAddr(node), idx);
+          batch.addRequest<GetSettingsCmd>(NodeAddr(node), page, true);
+        }
+        doNotOptimize(batch.data());
+      }
+    });
+  }
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3_provider.h"
+
+#include <memory>
+
+namespace bench {
+
+  // commands without response payload have no getData()
+  template <typename Cmd, typename = void>
+  struct HasGetData : std::false_type {};
+
+  template <typename Cmd>
+  struct HasGetData<Cmd, decltype(void(std::declval<Cmd &>().getData()))> : std::true_type {};
+
+  // valid response frame of the command filled with pattern bytes
+  template <typename Cmd>
+  std::vector<uint8_t> makeResponse() {
+    typedef typename Cmd::impl_type impl;
+    std::vector<uint8_t> payload(impl::recv_payload_size + 1, 0x11);
+    std::vector<uint8_t> frame(lgmc::FrameCodec::frameSize(impl::recv_payload_size));
+    lgmc::FrameCodec::encode(frame.data(), frame.size(), impl::command_id, payload.data(), impl::recv_payload_size);
+    return frame;
+  }
+
+  template <typename Cmd>
+  void addGetDataBenchmark(Runner & runner, const std::string & prefix, std::shared_ptr<std::vector<uint8_t>> response, std::true_type) {
+    runner.add(prefix + "/getData", [response](uint64_t n) {
+      Cmd c;
+      c.deserialize(response->data(), response->size());
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(c.getData());
+      }
+    });
+  }
+
+  template <typename Cmd>
+  void addGetDataBenchmark(Runner &, const std::string &, std::shared_ptr<std::vector<uint8_t>>, std::false_type) {
+  }
+
+  /* serialize (buffer, vector, with security bytes), deserialize (buffer, vector) and getData of the command
+   * vector paths use a new command per operation as the command keeps sent and received data
+   */
+  template <typename Cmd>
+  void addCommandBenchmarks(Runner & runner, const std::string & name) {
+    typedef typename Cmd::impl_type impl;
+    std::string prefix = "cmd/" + name;
+    std::shared_ptr<std::vector<uint8_t>> response = std::make_shared<std::vector<uint8_t>>(makeResponse<Cmd>());
+
+    runner.add(prefix + "/serialize/buffer", [](uint64_t n) {
+      Cmd c;
+      uint8_t buf[impl::secure_frame_size];
+      for (uint64_t i = 0; i < n; i++) {
+        // command may change between iterations, frame is not hoisted out of the loop
+        doNotOptimize(c);
+        doNotOptimize(c.serialize(buf, sizeof(buf)));
+        doNotOptimize(buf);
+      }
+    });
+
+    runner.add(prefix + "/serialize/vector", [](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        Cmd c;
+        doNotOptimize(c.serialize());
+      }
+    });
+
+    runner.add(prefix + "/serialize/security", [](uint64_t n) {
+      typename impl::send_type d;
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(d);
+        doNotOptimize(impl::encodeSecure(d));
+      }
+    });
+
+    runner.add(prefix + "/deserialize/buffer", [response](uint64_t n) {
+      Cmd c;
+      for (uint64_t i = 0; i < n; i++) {
+        c.deserialize(response->data(), response->size());
+        doNotOptimize(c);
+      }
+    }, response->size());
+
+    runner.add(prefix + "/deserialize/vector", [response](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        Cmd c;
+        c.deserialize(*response);
+        doNotOptimize(c);
+      }
+    }, response->size());
+
+    addGetDataBenchmark<Cmd>(runner, prefix, response, HasGetData<Cmd>());
+  }
+
+  // conversions and JSON encoding of the provider classes
+  void registerProviderBenchmarks(Runner & runner) {
+    using namespace lgmc;
+
+    runner.add("provider/GetVersion/getVersion", [](uint64_t n) {
+      GetVersion v;
+      std::vector<uint8_t> response = makeResponse<GetVersionCmd>();
+      v.deserialize(response.data(), response.size());
+      for (uint64_t i = 0; i < n; i++) {
+        GetVersion::Version version = v.getVersion();
+        doNotOptimize(version);
+      }
+    });
+
+    runner.add("provider/GetVersion/encode", [](uint64_t n) {
+      rapidjson::Document doc;
+      GetVersion::Version version{1, 2, 3, 4};
+      for (uint64_t i = 0; i < n; i++) {
+        rapidjson::Value val = version.encode(doc.GetAllocator());
+        doNotOptimize(val);
+      }
+    });
+
+    runner.add("provider/GetVersion/write", [](uint64_t n) {
+      JsonEncoder encoder;
+      GetVersion::Version version{1, 2, 3, 4};
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(encoder.encode(version));
+      }
+    });
+
+    runner.add("provider/GetReportLong/getReport", [](uint64_t n) {
+      GetReportLong r;
+      for (uint64_t i = 0; i < n; i++) {
+        GetReportLong::LongReport report = r.getReport();
+        doNotOptimize(report);
+      }
+    });
+
+    runner.add("provider/GetReportLong/encode", [](uint64_t n) {
+      rapidjson::Document doc;
+      GetReportLong::LongReport report{};
+      for (uint64_t i = 0; i < n; i++) {
+        rapidjson::Value val = report.encode(doc.GetAllocator());
+        doNotOptimize(val);
+      }
+    });
+
+    runner.add("provider/GetReportLong/write", [](uint64_t n) {
+      JsonEncoder encoder;
+      GetReportLong::LongReport report{};
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(encoder.encode(report));
+      }
+    });
+
+    runner.add("provider/GetFlags/isLongTestPass", [](uint64_t n) {
+      GetFlags f;
+      std::vector<uint8_t> response = makeResponse<GetFlagsCmd>();
+      f.deserialize(response.data(), response.size());
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(f.isLongTestPass());
+      }
+    });
+  }
+
+  void registerCommandBenchmarks(Runner & runner) {
+    using namespace lgmc;
+    addCommandBenchmarks<GetVersionCmd>(runner, "GetVersion");
+    addCommandBenchmarks<SetSettingsCmd>(runner, "SetSettings");
+    addCommandBenchmarks<SetSettingsPageCmd>(runner, "SetSettingsPage");
+    addCommandBenchmarks<GetSettingsCmd>(runner, "GetSettings");
+    addCommandBenchmarks<SetScheduleCmd>(runner, "SetSchedule");
+    addCommandBenchmarks<SetTimeAndDateCmd>(runner, "SetTimeAndDate");
+    addCommandBenchmarks<GetTimeAndDateCmd>(runner, "GetTimeAndDate");
+    addCommandBenchmarks<PresetTimeAndDateCmd>(runner, "PresetTimeAndDate");
+    addCommandBenchmarks<StartRtc>(runner, "StartRtc");
+    addCommandBenchmarks<ChangeRtcToPresetCmd>(runner, "ChangeRtcToPreset");
+    addCommandBenchmarks<TimeSyncCmd>(runner, "TimeSync");
+    addCommandBenchmarks<GetFlagsCmd>(runner, "GetFlags");
+    addCommandBenchmarks<ResetFlagsCmd>(runner, "ResetFlags");
+    addCommandBenchmarks<GetReportShortCmd>(runner, "GetReportShort");
+    addCommandBenchmarks<GetReportLongCmd>(runner, "GetReportLong");
+    addCommandBenchmarks<AcknowledgeReportCmd>(runner, "AcknowledgeReport");
+    addCommandBenchmarks<GetSystemStatus1Cmd>(runner, "GetSystemStatus1");
+    registerProviderBenchmarks(runner);
+  }
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3.h"
+
+#include <ctime>
+#include <memory>
+
+namespace bench {
+
+  // previous conversions through localtime() and mktime()
+  lgmc::DateTimeBase::data_send_t legacyFromTimePoint(const std::chrono::system_clock::time_point & tim) {
+    lgmc::DateTimeBase::data_send_t time;
+    time_t rawtime = std::chrono::system_clock::to_time_t(tim);
+    tm * tm = localtime(&rawtime);
+    time.time_second = tm->tm_sec;
+    time.time_hour = tm->tm_hour;
+    time.time_minute = tm->tm_min;
+    time.date_day = tm->tm_mday - 1;
+    time.date_month = tm->tm_mon;
+    time.date_year = (tm->tm_year + 1900) % 100;
+    time.date_century = lgmc::DateTimeBase::centuryFromYear(tm->tm_year + 1900);
+    return time;
+  }
+
+  std::chrono::system_clock::time_point legacyToTimePoint(const lgmc::DateTimeBase::data_recv_t & data) {
+    tm time = {};
+    time.tm_sec = data.time_second.data;
+    time.tm_min = data.time_minute.data;
+    time.tm_hour = data.time_hour.data;
+    time.tm_mday = data.date_day.data + 1;
+    time.tm_mon = data.date_month.data;
+    time.tm_year = lgmc::DateTimeBase::yearFromCentury(data.date_year.data, data.date_century.data) - 1900;
+    time.tm_isdst = -1;
+    return std::chrono::system_clock::from_time_t(mktime(&time));
+  }
+
+  // device timestamps are mostly ordered, consecutive dates are 61 s apart
+  lgmc::DateTimeBase::data_recv_t benchDate(uint64_t i) {
+    int64_t secs = 1640995200 + int64_t(i % 1000000) * 61;
+    int64_t days = lgmc::CivilTime::daysFromSeconds(secs);
+    int64_t s = secs - days * lgmc::CivilTime::seconds_per_day;
+    lgmc::CivilDate date = lgmc::CivilTime::civilFromDays(days);
+    lgmc::DateTimeBase::data_recv_t d;
+    d.time_second = int(s % 60);
+    d.time_minute = int(s / 60 % 60);
+    d.time_hour = int(s / 3600);
+    d.date_day = int(date.day - 1);
+    d.date_month = int(date.month - 1);
+    d.date_year = int(date.year % 100);
+    d.date_century = lgmc::DateTimeBase::centuryFromYear(date.year);
+    return d;
+  }
+
+  // archive of report start dates and times, one report per 3 hours
+  struct CompressedArchive {
+    std::vector<uint16_t> dates;
+    std::vector<uint16_t> times;
+
+    explicit CompressedArchive(size_t n) {
+      for (size_t i = 0; i < n; i++) {
+        lgmc::DateTimeBase::data_recv_t d = benchDate(i * 177);
+        lgmc::System_Compressed_Date cd;
+        cd.set_year(d.date_year.data);
+        cd.set_month(d.date_month.data);
+        cd.set_day_of_month(d.date_day.data);
+        lgmc::System_Compressed_Time ct;
+        ct.set_hours(d.time_hour.data);
+        ct.set_minute(d.time_minute.data);
+        ct.set_seconds(d.time_second.data / 2);
+        dates.push_back(cd.data.data);
+        times.push_back(ct.data.data);
+      }
+    }
+  };
+
+  void registerDateTimeBenchmarks(Runner & runner) {
+    using namespace lgmc;
+    const int64_t base = 1640995200;
+
+    runner.add("time/fromTimePoint/localtime", [base](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(legacyFromTimePoint(std::chrono::system_clock::from_time_t(time_t(base + i * 61))));
+      }
+    });
+
+    runner.add("time/fromTimePoint/civil", [base](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(DateTimeBase::convertFromTimePoint(std::chrono::system_clock::from_time_t(time_t(base + i * 61))));
+      }
+    });
+
+    runner.add("time/toTimePoint/mktime", [](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(legacyToTimePoint(benchDate(i)));
+      }
+    });
+
+    runner.add("time/toTimePoint/civil", [](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(DateTimeBase::convertToTimePoint(benchDate(i)));
+      }
+    });
+
+    const size_t archive_size = 4096;
+    std::shared_ptr<CompressedArchive> archive = std::make_shared<CompressedArchive>(archive_size);
+
+    // field by field unpacking followed by mktime()
+    runner.add("time/compressed/mktime", [archive](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        lgmc::System_Compressed_Date cd;
+        lgmc::System_Compressed_Time ct;
+        cd.data.data = archive->dates[i % archive->dates.size()];
+        ct.data.data = archive->times[i % archive->times.size()];
+        DateTimeBase::data_recv_t data;
+        data.date_year = int(cd.year());
+        data.date_month = int(cd.month());
+        data.date_day = int(cd.day_of_month());
+        data.date_century = 20;
+        data.time_hour = int(ct.hour());
+        data.time_minute = int(ct.minute());
+        data.time_second = int(ct.seconds() * 2);
+        doNotOptimize(legacyToTimePoint(data));
+      }
+    }, 4);
+
+    runner.add("time/compressed/single", [archive](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        lgmc::System_Compressed_Date cd;
+        lgmc::System_Compressed_Time ct;
+        cd.data.data = archive->dates[i % archive->dates.size()];
+        ct.data.data = archive->times[i % archive->times.size()];
+        doNotOptimize(CompressedDateTime::toSeconds(cd, ct));
+      }
+    }, 4);
+
+    // ns/op is per decoded value
+    runner.add("time/compressed/batch", [archive](uint64_t n) {
+      std::vector<int64_t> out(archive->dates.size());
+      for (uint64_t done = 0; done < n; done += out.size()) {
+        size_t count = size_t(std::min<uint64_t>(out.size(), n - done));
+        CompressedDateTime::toSeconds(archive->dates.data(), archive->times.data(), count, out.data());
+        doNotOptimize(out);
+      }
+    }, 4);
+
+    runner.add("time/compressed/batch/utc", [archive](uint64_t n) {
+      std::vector<int64_t> out(archive->dates.size());
+      for (uint64_t done = 0; done < n; done += out.size()) {
+        size_t count = size_t(std::min<uint64_t>(out.size(), n - done));
+        CompressedDateTime::toSeconds(archive->dates.data(), archive->times.data(), count, out.data(), TimeZone::utc());
+        doNotOptimize(out);
+      }
+    }, 4);
+
+    // mktime() and localtime() serialise on the time zone lock
+    runner.add("time/toTimePoint/mktime/4threads", [](uint64_t n) {
+      runThreads(4, n, [](uint64_t i) {
+        doNotOptimize(legacyToTimePoint(benchDate(i)));
+      });
+    });
+
+    runner.add("time/toTimePoint/civil/4threads", [](uint64_t n) {
+      runThreads(4, n, [](uint64_t i) {
+        doNotOptimize(DateTimeBase::convertToTimePoint(benchDate(i)));
+      });
+    });
+  }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3_provider.h"
+#include "repM3_flag_index.h"
+#include "repM3_flag_events.h"
+
+#include <memory>
+#include <random>
+
+namespace bench {
+
+  // "which nodes have fault X" over the fleet: loop over per-node structs vs flag bitmaps
+  void registerFlagIndexBenchmarks(Runner & runner) {
+    using namespace lgmc;
+    const size_t nodes = 60000;
+
+    std::shared_ptr<std::vector<GetFlagsCmd::data_t>> structs = std::make_shared<std::vector<GetFlagsCmd::data_t>>(nodes);
+    std::shared_ptr<FlagIndex> index = std::make_shared<FlagIndex>();
+
+    std::mt19937 rnd(7);
+    for (size_t i = 0; i < nodes; i++) {
+      GetFlagsCmd::data_t &f = (*structs)[i];
+      std::memset(static_cast<void *>(&f), 0, sizeof(f));
+      // few percent of faulty nodes
+      f.error_flags.data = rnd() % 32 == 0 ? uint16_t(rnd() & 0x7F) : 0;
+      f.warning_flags.data = rnd() % 16 == 0 ? uint16_t(rnd() & 0x7) : 0;
+      f.system_status_info.data = uint8_t(rnd());
+      index->update(NodeAddr(i), f);
+    }
+
+    runner.add("flags/structs/count/60k", [structs](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        size_t count = 0;
+        for (const GetFlagsCmd::data_t & f : *structs) {
+          count += f.error_flags.f5() ? 1 : 0;
+        }
+        doNotOptimize(count);
+      }
+    }, nodes * sizeof(GetFlagsCmd::data_t));
+
+    runner.add("flags/index/count/60k", [index](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(index->count(FlagIndex::LED_OVER_CURRENT_TRIP));
+      }
+    }, nodes / 8);
+
+    // led_over_current_trip or led_over_voltage_trip, rtc running and mains on
+    runner.add("flags/structs/select/60k", [structs](uint64_t n) {
+      std::vector<NodeAddr> result;
+      for (uint64_t i = 0; i < n; i++) {
+        result.clear();
+        for (size_t node = 0; node < structs->size(); node++) {
+          const GetFlagsCmd::data_t & f = (*structs)[node];
+          if ((f.error_flags.f5() || f.error_flags.f3()) && !f.error_flags.f0() && f.system_status_info.f2()) {
+            result.push_back(NodeAddr(node));
+          }
+        }
+        doNotOptimize(result);
+      }
+    }, nodes * sizeof(GetFlagsCmd::data_t));
+
+    runner.add("flags/index/select/60k", [index](uint64_t n) {
+      FlagIndex::Query q;
+      q.any(FlagIndex::LED_OVER_CURRENT_TRIP).any(FlagIndex::LED_OVER_VOLTAGE_TRIP)
+        .none(FlagIndex::RTC_NOT_RUNNING).all(FlagIndex::MAINS_ON);
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(index->select(q));
+      }
+    }, nodes / 8 * 4);
+
+    // publication of one poll cycle where 0.1 % of nodes changed: full state JSON vs flipped bits
+    runner.add("flags/publish/full/60k", [structs](uint64_t n) {
+      JsonEncoder encoder;
+      GetFlags::Flags f;
+      for (uint64_t i = 0; i < n; i++) {
+        size_t bytes = 0;
+        for (const GetFlagsCmd::data_t & d : *structs) {
+          f.green = d.info_flags.data;
+          f.yellow = d.warning_flags.data;
+          f.red = d.error_flags.data;
+          f.systemStatus = d.system_status_info.data;
+          f.additionalStatus = d.additional_status_info.data;
+          encoder.encode(f);
+          bytes += encoder.size();
+        }
+        doNotOptimize(bytes);
+      }
+    });
+
+    runner.add("flags/publish/events/60k", [structs](uint64_t n) {
+      FlagEventStream stream;
+      std::vector<FlagEvent> events;
+      stream.onEvent([&events](const FlagEvent & e) {
+        events.push_back(e);
+      });
+      std::vector<GetFlagsCmd::data_t> cycle(*structs);
+      for (size_t node = 0; node < cycle.size(); node++) {
+        stream.update(NodeAddr(node), cycle[node]);
+      }
+      for (uint64_t i = 0; i < n; i++) {
+        events.clear();
+        for (size_t k = 0; k < cycle.size() / 1000; k++) {
+          cycle[(i * 7919 + k * 1009) % cycle.size()].error_flags.data ^= 0x20;
+        }
+        for (size_t node = 0; node < cycle.size(); node++) {
+          stream.update(NodeAddr(node), cycle[node]);
+        }
+        doNotOptimize(events);
+      }
+    });
+
+    runner.add("flags/index/update", [structs, index](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        size_t node = i % structs->size();
+        index->update(NodeAddr(node), (*structs)[node]);
+      }
+      doNotOptimize(*index);
+    });
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3_sim_transport.h"
+#include "repM3_flags_poller.h"
+#include "repM3_emulator.h"
+
+#include <memory>
+
+namespace bench {
+
+  // emulated fleet, every 16th device has red flags set
+  std::shared_ptr<lgmc::DeviceEmulator> makeFleet(size_t nodes, double drop_rate = 0) {
+    using namespace lgmc;
+    DeviceEmulator::Config cfg;
+    cfg.drop_rate = drop_rate;
+    std::shared_ptr<DeviceEmulator> fleet = std::make_shared<DeviceEmulator>(cfg);
+    fleet->reserve(nodes);
+    for (size_t i = 0; i < nodes; i++) {
+      fleet->add(NodeAddr(i)).flags.error_flags.data = i % 16 == 0 ? 0x2 : 0;
+    }
+    return fleet;
+  }
+
+  // one operation is a poll cycle over the whole fleet
+  void registerPollerBenchmarks(Runner & runner) {
+    using namespace lgmc;
+
+    struct Scenario {
+      size_t nodes;
+      double drop_rate;
+      const char * name;
+    };
+    const Scenario scenarios[] = {
+      {1000, 0, "poller/cycle/1000nodes"},
+      {10000, 0, "poller/cycle/10000nodes"},
+      {10000, 0.01, "poller/cycle/10000nodes/drop1%"},
+    };
+
+    for (const Scenario & sc : scenarios) {
+      size_t nodes = sc.nodes;
+      double drop_rate = sc.drop_rate;
+      runner.add(sc.name, [nodes, drop_rate](uint64_t n) {
+        std::shared_ptr<DeviceEmulator> fleet = makeFleet(nodes, drop_rate);
+        SimTransport::Config simCfg;
+        simCfg.max_in_flight = 128;
+        SimTransport transport(std::ref(*fleet), simCfg);
+        FlagsPoller::Config cfg;
+        // dropped requests end the cycle after the timeout
+        cfg.timeout = std::chrono::milliseconds(1);
+        FlagsPoller poller(transport, cfg);
+        for (size_t i = 0; i < nodes; i++) {
+          poller.addNode(NodeAddr(i));
+        }
+        for (uint64_t i = 0; i < n; i++) {
+          poller.runCycle();
+        }
+        doNotOptimize(poller.stats().polls);
+      });
+    }
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3_provider.h"
+#include "repM3_report_store.h"
+
+#include <memory>
+#include <random>
+
+namespace bench {
+
+  // fleet-wide scans of one field: decoded LongReport objects vs columnar store
+  void registerReportStoreBenchmarks(Runner & runner) {
+    using namespace lgmc;
+    const size_t reports = 1000000;
+    const uint16_t threshold = 3500;
+
+    std::shared_ptr<std::vector<GetReportLong::LongReport>> objects = std::make_shared<std::vector<GetReportLong::LongReport>>();
+    std::shared_ptr<LongReportStore> store = std::make_shared<LongReportStore>();
+    objects->reserve(reports);
+    store->reserve(reports);
+
+    std::mt19937 rnd(3);
+    Long_Test_Report r;
+    std::memset(static_cast<void *>(&r), 0, sizeof(r));
+    for (size_t i = 0; i < reports; i++) {
+      r.end_bottom_cell_volts.data = uint16_t(2500 + rnd() % 2000);
+      r.bot_cell_amp_hours.data = uint16_t(rnd() % 4000);
+      store->append(NodeAddr(i % 10000), r);
+
+      GetReportLong::LongReport o{};
+      o.endBottomVolts = r.end_bottom_cell_volts.data;
+      o.bottomCellAmpHours = r.bot_cell_amp_hours.data;
+      objects->push_back(o);
+    }
+
+    runner.add("reports/objects/summary/1M", [objects](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        uint16_t lo = 0xFFFF;
+        uint16_t hi = 0;
+        uint64_t sum = 0;
+        for (const GetReportLong::LongReport & o : *objects) {
+          lo = std::min(lo, o.endBottomVolts);
+          hi = std::max(hi, o.endBottomVolts);
+          sum += o.endBottomVolts;
+        }
+        double mean = double(sum) / objects->size();
+        doNotOptimize(lo);
+        doNotOptimize(hi);
+        doNotOptimize(mean);
+      }
+    }, reports * sizeof(GetReportLong::LongReport));
+
+    runner.add("reports/columns/summary/1M", [store](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        ColumnSummary s = store->summary(LongReportStore::END_BOTTOM_CELL_VOLTS);
+        doNotOptimize(s);
+      }
+    }, reports * sizeof(uint16_t));
+
+    runner.add("reports/objects/countAbove/1M", [objects, threshold](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        size_t count = 0;
+        for (const GetReportLong::LongReport & o : *objects) {
+          count += o.endBottomVolts > threshold;
+        }
+        doNotOptimize(count);
+      }
+    }, reports * sizeof(GetReportLong::LongReport));
+
+    runner.add("reports/columns/countAbove/1M", [store, threshold](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(store->countAbove(LongReportStore::END_BOTTOM_CELL_VOLTS, threshold));
+      }
+    }, reports * sizeof(uint16_t));
+  }
+}
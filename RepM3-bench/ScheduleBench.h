@@ -0,0 +1,69 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3_schedule.h"
+
+#include <memory>
+#include <numeric>
+
+namespace bench {
+
+  // next occurrence by iterating days and testing every mask
+  bool scheduleNextByDays(const lgmc::Test_Schedule & s, int64_t from, int64_t & occurrence) {
+    using namespace lgmc;
+    const int64_t start = ScheduleEngine::startSeconds(s);
+    const int64_t first = CivilTime::daysFromSeconds(from);
+    for (int64_t d = first; d < first + 366 * ScheduleEngine::max_years; d++) {
+      CivilDate date = CivilTime::civilFromDays(d);
+      if (d * CivilTime::seconds_per_day + start >= from
+          && ScheduleEngine::yearMatches(s, date.year)
+          && (s.months.data >> (date.month - 1) & 1)
+          && (s.days_of_month.data >> (date.day - 1) & 1)
+          && (s.days_of_week.data >> CivilTime::weekdayFromDays(d) & 1)) {
+        occurrence = d * CivilTime::seconds_per_day + start;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // next 10 occurrences of sparse schedule: day by day vs month masks, stagger plan of the fleet
+  void registerScheduleBenchmarks(Runner & runner) {
+    using namespace lgmc;
+    std::shared_ptr<Test_Schedule> sparse = std::make_shared<Test_Schedule>();
+    // last Friday of the quarter falling on 25th - 31st
+    sparse->start_time.hr = 2;
+    sparse->days_of_week.data = 1 << 5;
+    sparse->days_of_month.data = 0x7Fu << 24;
+    sparse->months.data = 1 << 2 | 1 << 5 | 1 << 8 | 1 << 11;
+    const int64_t from = CivilTime::daysFromCivil(2024, 1, 1) * CivilTime::seconds_per_day;
+
+    runner.add("schedule/days/next10", [sparse, from](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        int64_t t = from;
+        int64_t occurrence = 0;
+        for (int k = 0; k < 10 && scheduleNextByDays(*sparse, t, occurrence); k++) {
+          t = occurrence + 1;
+        }
+        doNotOptimize(occurrence);
+      }
+    });
+
+    runner.add("schedule/engine/next10", [sparse, from](uint64_t n) {
+      int64_t occurrences[10];
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(*sparse);
+        doNotOptimize(ScheduleEngine::next(*sparse, from, 10, occurrences));
+        doNotOptimize(occurrences);
+      }
+    });
+
+    std::shared_ptr<std::vector<NodeAddr>> nodes = std::make_shared<std::vector<NodeAddr>>(10000);
+    std::iota(nodes->begin(), nodes->end(), NodeAddr(1));
+    runner.add("schedule/stagger/plan/10k", [sparse, nodes](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(StaggerPlanner::plan(*sparse, *nodes));
+      }
+    });
+  }
+}
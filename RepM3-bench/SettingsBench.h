@@ -0,0 +1,85 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "PollerBench.h"
+#include "repM3_settings_sync.h"
+
+#include <memory>
+
+namespace bench {
+
+  // settings page codec and fleet-wide push of a config change
+  void registerSettingsBenchmarks(Runner & runner) {
+    using namespace lgmc;
+    const size_t pages = 1024;
+
+    runner.add("settings/decode/1024pages", [pages](uint64_t n) {
+      std::vector<System_Settings_page0> p(pages);
+      std::vector<uint16_t> values(pages * SettingsCodec::fields);
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(p);
+        SettingsCodec::decode(p.data(), p.size(), values.data());
+        doNotOptimize(values);
+      }
+    }, pages * SettingsCodec::page_size);
+
+    runner.add("settings/diff", [](uint64_t n) {
+      System_Settings_page0 a;
+      System_Settings_page0 b;
+      std::memset(static_cast<void *>(&a), 0, sizeof(a));
+      std::memset(static_cast<void *>(&b), 0, sizeof(b));
+      b.test_voltage_upper_limit.data = 3;
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(a);
+        doNotOptimize(SettingsCodec::diff(a, b));
+      }
+    });
+
+    /* one operation is the push of page 0 to 20k nodes, 1 % of them differ
+     * known: actual content is known from earlier reads, unknown: every page is read first,
+     * all: SetSettings to every node without comparison
+     */
+    struct Scenario {
+      bool known;
+      bool write_all;
+      const char * name;
+    };
+    const Scenario scenarios[] = {
+      {true, false, "settings/push/20k/known"},
+      {false, false, "settings/push/20k/unknown"},
+      {false, true, "settings/push/20k/all"},
+    };
+    const size_t nodes = 20000;
+    SettingsCodec::Values v{};
+    v[0] = 100;
+    const System_Settings_page0 desired = SettingsCodec::encode(v);
+    std::shared_ptr<DeviceEmulator> fleet = makeFleet(nodes);
+
+    for (const Scenario & sc : scenarios) {
+      runner.add(sc.name, [sc, fleet, desired, nodes](uint64_t n) {
+        System_Settings_page0 old;
+        std::memset(static_cast<void *>(&old), 0, sizeof(old));
+        for (uint64_t i = 0; i < n; i++) {
+          SimTransport transport(std::ref(*fleet));
+          SettingsSync::Config cfg;
+          cfg.window = 128;
+          SettingsSync sync(transport, cfg);
+          sync.setDesired(0, desired);
+          for (size_t node = 0; node < nodes; node++) {
+            DeviceState *d = fleet->device(NodeAddr(node));
+            std::memcpy(static_cast<void *>(&d->settings[0]), node % 100 == 0 ? &old : &desired, sizeof(desired));
+            sync.addNode(NodeAddr(node));
+            if (sc.known) {
+              sync.setActual(NodeAddr(node), 0, d->settings[0]);
+            } else if (sc.write_all) {
+              // compared with differing content, every page is written
+              sync.setActual(NodeAddr(node), 0, old);
+            }
+          }
+          sync.run();
+          doNotOptimize(transport.sent());
+        }
+      });
+    }
+  }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3.h"
+
+#include <fstream>
+#include <memory>
+
+namespace bench {
+
+  // resident set size of the process, 0 where /proc is not available
+  inline size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    if (!(statm >> pages >> resident)) {
+      return 0;
+    }
+    return resident * 4096;
+  }
+
+  // poll cycle of long-running gateway: the same command objects encode requests and decode responses
+  struct SoakCycle {
+    lgmc::GetSettingsCmd settings;
+    lgmc::GetFlagsCmd flags;
+    std::vector<uint8_t> settings_response;
+    std::vector<uint8_t> flags_response;
+    std::vector<uint8_t> request;
+
+    SoakCycle()
+    : settings_response(lgmc::Codec<lgmc::GetSettingsCmd>::response_size),
+      flags_response(lgmc::Codec<lgmc::GetFlagsCmd>::response_size) {
+      using namespace lgmc;
+      GetSettingsCmd::data_t page{};
+      FrameCodec::encode(settings_response.data(), settings_response.size(), CMD_GET_SETTINGS, &page, sizeof(page));
+      GetFlagsCmd::data_t f{};
+      FrameCodec::encode(flags_response.data(), flags_response.size(), CMD_GET_FLAGS, &f, sizeof(f));
+    }
+
+    void run(uint64_t i) {
+      settings.setPage(uint8_t(i % 4));
+      settings.serialize(request);
+      settings.deserialize(settings_response);
+      doNotOptimize(settings.getData());
+      flags.serialize(request);
+      flags.deserialize(flags_response);
+      doNotOptimize(flags.getData());
+    }
+
+    size_t capacity() const {
+      return settings.capacity() + flags.capacity() + request.capacity();
+    }
+  };
+
+  void registerSoakBenchmarks(Runner & runner) {
+    runner.add("soak/cycle/reuse", [](uint64_t n) {
+      SoakCycle cycle;
+      for (uint64_t i = 0; i < n; i++) {
+        cycle.run(i);
+      }
+      doNotOptimize(cycle.capacity());
+    });
+  }
+
+  // runs cycles with reused commands and prints RSS and buffer capacity at 10 checkpoints, memory has to stay flat
+  void runSoak(uint64_t cycles, FILE * out) {
+    std::unique_ptr<SoakCycle> cycle(new SoakCycle());
+    const uint64_t step = std::max<uint64_t>(1, cycles / 10);
+    fprintf(out, "%-16s %16s %16s\n", "cycles", "rss_kb", "capacity");
+    fprintf(out, "%-16llu %16llu %16llu\n", 0ull, (unsigned long long)residentBytes() / 1024, (unsigned long long)cycle->capacity());
+    for (uint64_t i = 0; i < cycles; i++) {
+      cycle->run(i);
+      if ((i + 1) % step == 0) {
+        fprintf(out, "%-16llu %16llu %16llu\n", (unsigned long long)(i + 1), (unsigned long long)residentBytes() / 1024,
+          (unsigned long long)cycle->capacity());
+      }
+    }
+  }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "CommandBench.h"
+#include "repM3_provider.h"
+#include "repM3_state_cache.h"
+
+#include <memory>
+
+namespace bench {
+
+  // handling of repeated GetSettings response: decode and JSON every time vs change detection in the cache
+  void registerStateCacheBenchmarks(Runner & runner) {
+    using namespace lgmc;
+    const size_t nodes = 1000;
+    std::shared_ptr<std::vector<uint8_t>> response = std::make_shared<std::vector<uint8_t>>(makeResponse<GetSettingsCmd>());
+
+    runner.add("cache/settings/decode+json", [response](uint64_t n) {
+      GetSettings s;
+      JsonEncoder encoder;
+      for (uint64_t i = 0; i < n; i++) {
+        s.deserialize(response->data(), response->size());
+        doNotOptimize(encoder.encode(s.getSettings()));
+      }
+    }, response->size());
+
+    runner.add("cache/settings/unchanged", [response, nodes](uint64_t n) {
+      DeviceStateCache cache;
+      GetSettings s;
+      JsonEncoder encoder;
+      FrameView frame(response->data(), response->size());
+      for (uint64_t i = 0; i < n; i++) {
+        if (cache.update(NodeAddr(i % nodes), frame) != DeviceStateCache::UNCHANGED) {
+          s.deserialize(response->data(), response->size());
+          doNotOptimize(encoder.encode(s.getSettings()));
+        }
+      }
+    }, response->size());
+
+    // poll decision per node and command
+    runner.add("cache/isFresh", [response, nodes](uint64_t n) {
+      DeviceStateCache cache;
+      FrameView frame(response->data(), response->size());
+      for (size_t node = 0; node < nodes; node++) {
+        cache.update(NodeAddr(node), frame);
+      }
+      for (uint64_t i = 0; i < n; i++) {
+        doNotOptimize(cache.isFresh<GetSettingsCmd>(NodeAddr(i % nodes)));
+      }
+    });
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BenchUtils.h"
+#include "repM3_stream.h"
+
+#include <memory>
+#include <random>
+
+namespace bench {
+
+  // stream of GetVersion/GetFlags/GetReport frames with random noise between them
+  std::vector<uint8_t> makeNoisyStream(size_t size, unsigned noise_percent) {
+    using namespace lgmc;
+    std::mt19937 rnd(1);
+    std::vector<uint8_t> stream;
+    stream.reserve(size + FrameStreamParser::max_frame_size);
+
+    GetReportLongCmd::data_t_long report;
+    std::memset(static_cast<void *>(&report), 0x5A, sizeof(report));
+    GetFlagsCmd::data_t flags;
+    std::memset(static_cast<void *>(&flags), 0x01, sizeof(flags));
+    GetVersionCmd::data_t version;
+    std::memset(static_cast<void *>(&version), 0x02, sizeof(version));
+
+    uint8_t frame[FrameStreamParser::max_frame_size];
+    while (stream.size() < size) {
+      size_t n = 0;
+      switch (rnd() % 3) {
+        case 0:
+          n = FrameCodec::encode(frame, sizeof(frame), CMD_GET_REPORT, &report, sizeof(report));
+          break;
+        case 1:
+          n = FrameCodec::encode(frame, sizeof(frame), CMD_GET_FLAGS, &flags, sizeof(flags));
+          break;
+        default:
+          n = FrameCodec::encode(frame, sizeof(frame), CMD_GET_VERSION, &version, sizeof(version));
+          break;
+      }
+      stream.insert(stream.end(), frame, frame + n);
+      if (rnd() % 100 < noise_percent) {
+        size_t garbage = rnd() % 16;
+        for (size_t i = 0; i < garbage; i++) {
+          stream.push_back(uint8_t(rnd()));
+        }
+      }
+    }
+    return stream;
+  }
+
+  void registerStreamBenchmarks(Runner & runner) {
+    using namespace lgmc;
+    const size_t stream_size = 4 * 1024 * 1024;
+
+    for (unsigned noise : {0u, 5u}) {
+      std::shared_ptr<std::vector<uint8_t>> stream = std::make_shared<std::vector<uint8_t>>(makeNoisyStream(stream_size, noise));
+      std::string name = "stream/parse/4MB/noise" + std::to_string(noise) + "%";
+
+      runner.add(name, [stream](uint64_t n) {
+        std::mt19937 rnd(2);
+        FrameStreamParser parser(64 * 1024);
+        for (uint64_t i = 0; i < n; i++) {
+          size_t frames = 0;
+          size_t pos = 0;
+          // chunks of random size like from read()
+          while (pos < stream->size()) {
+            size_t chunk = std::min(size_t(1 + rnd() % 1024), stream->size() - pos);
+            frames += parser.parse(stream->data() + pos, chunk, [](const FrameView & f) {
+              doNotOptimize(f);
+            });
+            pos += chunk;
+          }
+          doNotOptimize(frames);
+        }
+      }, stream->size());
+    }
+  }
+}
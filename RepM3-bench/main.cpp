@@ -0,0 +1,131 @@
+#include "BenchUtils.h"
+#include "CodecBench.h"
+#include "StreamBench.h"
+#include "ChecksumBench.h"
+#include "PollerBench.h"
+#include "CommandBench.h"
+#include "ReportStoreBench.h"
+#include "DateTimeBench.h"
+#include "FlagIndexBench.h"
+#include "StateCacheBench.h"
+#include "SettingsBench.h"
+#include "ScheduleBench.h"
+#include "BroadcastBench.h"
+#include "SoakBench.h"
+
+#include <cstdlib>
+#include <new>
+
+// replacements are not inlined so the compiler doesn't pair the inlined malloc with delete expressions
+#ifdef _MSC_VER
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+// count every heap allocation to report allocs/op and bytes/op
+BENCH_NOINLINE void * operator new(size_t size) {
+  bench::AllocCounter::count()++;
+  bench::AllocCounter::bytes() += size;
+  void * p = std::malloc(size ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+BENCH_NOINLINE void * operator new[](size_t size) {
+  return operator new(size);
+}
+
+BENCH_NOINLINE void operator delete(void * p) noexcept {
+  std::free(p);
+}
+
+BENCH_NOINLINE void operator delete(void * p, size_t) noexcept {
+  std::free(p);
+}
+
+BENCH_NOINLINE void operator delete[](void * p) noexcept {
+  std::free(p);
+}
+
+BENCH_NOINLINE void operator delete[](void * p, size_t) noexcept {
+  std::free(p);
+}
+
+void usage(const char * name) {
+  fprintf(stderr, "usage: %s [filter] [--format=table|json|csv] [--out=file] [--min-time=ms] [--soak=cycles]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+  // optional filter selects benchmarks by name
+  std::string filter;
+  std::string out;
+  bench::Format format = bench::FORMAT_TABLE;
+  double min_time_ms = 200;
+  // number of cycles of the memory soak test instead of benchmarks
+  unsigned long long soak = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--format=json") {
+      format = bench::FORMAT_JSON;
+    } else if (arg == "--format=csv") {
+      format = bench::FORMAT_CSV;
+    } else if (arg == "--format=table") {
+      format = bench::FORMAT_TABLE;
+    } else if (arg.compare(0, 6, "--out=") == 0) {
+      out = arg.substr(6);
+    } else if (arg.compare(0, 11, "--min-time=") == 0) {
+      min_time_ms = std::atof(arg.c_str() + 11);
+    } else if (arg.compare(0, 7, "--soak=") == 0) {
+      soak = std::strtoull(arg.c_str() + 7, nullptr, 10);
+    } else if (arg.compare(0, 2, "--") == 0) {
+      usage(argv[0]);
+      return 1;
+    } else {
+      filter = arg;
+    }
+  }
+
+  if (soak != 0) {
+    bench::runSoak(soak, stdout);
+    return 0;
+  }
+
+  bench::Runner runner(min_time_ms);
+  // keep stdout clean for machine-readable results
+  if (format != bench::FORMAT_TABLE && out.empty()) {
+    runner.setLog(stderr);
+  }
+  bench::registerCodecBenchmarks(runner);
+  bench::registerStreamBenchmarks(runner);
+  bench::registerChecksumBenchmarks(runner);
+  bench::registerPollerBenchmarks(runner);
+  bench::registerCommandBenchmarks(runner);
+  bench::registerReportStoreBenchmarks(runner);
+  bench::registerDateTimeBenchmarks(runner);
+  bench::registerFlagIndexBenchmarks(runner);
+  bench::registerStateCacheBenchmarks(runner);
+  bench::registerSettingsBenchmarks(runner);
+  bench::registerScheduleBenchmarks(runner);
+  bench::registerBroadcastBenchmarks(runner);
+  bench::registerSoakBenchmarks(runner);
+  runner.run(filter);
+
+  if (format != bench::FORMAT_TABLE || !out.empty()) {
+    FILE * f = out.empty() ? stdout : fopen(out.c_str(), "w");
+    if (f == nullptr) {
+      fprintf(stderr, "can't open %s\n", out.c_str());
+      return 1;
+    }
+    runner.write(f, format);
+    if (f != stdout) {
+      fclose(f);
+    }
+  }
+
+  return 0;
+}
@@ -1,7 +1,27 @@
 #include "repM3.h"
 #include "repM3_provider.h"
+#include "repM3_stream.h"
+#include "repM3_dispatch.h"
+#include "repM3_batch.h"
+#include "repM3_report_download.h"
+#include "repM3_sim_transport.h"
+#include "repM3_flags_poller.h"
+#include "repM3_emulator.h"
+#include "repM3_report_store.h"
+#include "repM3_flag_index.h"
+#include "repM3_state_cache.h"
+#include "repM3_flag_events.h"
+#include "repM3_settings_sync.h"
+#include "repM3_schedule.h"
+#include "repM3_broadcast.h"
+#include "repM3_time_sync.h"
 #include <iostream>
 #include <string>
+#include <map>
+#include <set>
+#include <numeric>
+#include <thread>
+#include <cstdlib>
 
 #include <gtest/gtest.h>
 
@@ -207,25 +227,51 @@ TEST(get_version_cmd, command_handler) {
     EXPECT_EQ(d.fw_pre_release_nr, 0x2);
     EXPECT_EQ(d.hw_variant, 0x0);
 }
-#if 0
 TEST(set_settings_cmd, command_handler) {
     SetSettingsCmd cmd;
     
     cmd.set_system_settings_page();
     cmd.set_date(10,5,22);
 
-    std::vector<uint8_t> d = cmd.serialize(cmd.data_sent);
+    std::vector<uint8_t> d = cmd.serialize();
     
-    std::vector<uint8_t> exp{0xb1,0x2,0x10,0x0,0xaa,0x2c,0xe8,0xb2};
+    // page 0 and compressed date 0x2caa, len counts id and payload
+    std::vector<uint8_t> exp{0xb1,0x4,0x10,0x0,0xaa,0x2c,0xea,0xb2};
 
     EXPECT_EQ(d, exp);
 
-    SetSettingsCmd::data_t r;
-    bool ok = cmd.deserialize(std::vector<uint8_t>{0xB1, 0x0, 0x10, 0xAA, 0xBA, 0xB2}, &r);
-    EXPECT_EQ(ok, true);
-    EXPECT_EQ(r.status, 170);
+    cmd.deserialize(std::vector<uint8_t>{0xB1, 0x2, 0x10, 0xAA, 0xBC, 0xB2});
+    EXPECT_EQ(cmd.getData().status, 170);
+    EXPECT_TRUE(cmd.getStatus());
+}
+TEST(set_settings_page_cmd, command_handler) {
+    SetSettingsPageCmd cmd;
+    SettingsCodec::Values values{};
+    values[0] = 0x1234;
+    // upper 2 bits are dropped
+    values[14] = 0xFFFF;
+    cmd.setPage(2);
+    cmd.setSettings(values);
+
+    std::vector<uint8_t> d = cmd.serialize();
+    ASSERT_EQ(d.size(), 2 + 1 + 4 + 1 + SettingsCodec::page_size + 2);
+    FrameView frame(d.data(), d.size());
+    EXPECT_TRUE(frame.isValid(CMD_SET_SETTINGS));
+    // security bytes, page and first field little endian
+    EXPECT_EQ(d[3], 9);
+    EXPECT_EQ(d[4], 227);
+    EXPECT_EQ(d[7], 2);
+    EXPECT_EQ(d[8], 0x34);
+    EXPECT_EQ(d[9], 0x12);
+    EXPECT_EQ(d[8 + 28], 0xFF);
+    EXPECT_EQ(d[8 + 29], 0x3F);
+
+    uint8_t status = 170;
+    uint8_t response[8];
+    size_t n = FrameCodec::encode(response, sizeof(response), CMD_SET_SETTINGS, &status, 1);
+    cmd.deserialize(response, n);
+    EXPECT_TRUE(cmd.getStatus());
 }
-#endif
 TEST(get_version, cmd_test) {
     GetVersion ver;
     std::vector<uint8_t> exp{0xB1, 0x1, 0x9, 0xA, 0xB2};
@@ -347,3 +393,1828 @@ TEST(centuryToYear, data) {
 }
 
 
+
+TEST(serializeToBuffer, command_handler) {
+    GetFlagsCmd flags;
+    uint8_t buf[16];
+
+    size_t n = flags.serialize(buf, sizeof(buf));
+    std::vector<uint8_t> exp = GetFlagsCmd().serialize();
+
+    ASSERT_EQ(n, exp.size());
+    EXPECT_EQ(std::vector<uint8_t>(buf, buf + n), exp);
+
+    // buffer too small
+    EXPECT_EQ(flags.serialize(buf, exp.size() - 1), 0);
+}
+
+TEST(serializeToBufferSecurity, command_handler) {
+    GetSettingsCmd cmd;
+    cmd.setPage(1);
+    std::array<uint8_t, 10> buf;
+
+    std::vector<uint8_t> exp{0xB1, 0x6, 15, 9, 227, 228, 15, 1, 0xF5, 0xB2};
+    size_t n = cmd.serialize(buf.data(), buf.size());
+    ASSERT_EQ(n, exp.size());
+    EXPECT_EQ(std::vector<uint8_t>(buf.begin(), buf.end()), exp);
+
+    ChangeRtcToPresetCmd rtc;
+    std::vector<uint8_t> expRtc{0xB1, 0x5, 23, 9, 227, 224, 23, 0xFF, 0xB2};
+    n = rtc.serialize(buf.data(), buf.size(), true);
+    EXPECT_EQ(std::vector<uint8_t>(buf.begin(), buf.begin() + n), expRtc);
+}
+
+TEST(frameView, command_handler) {
+    std::vector<uint8_t> frame{0xB1,0x5,0x9,0x5,0x1,0x2,0x0,0x16,0xB2};
+    FrameView v(frame.data(), frame.size());
+
+    ASSERT_TRUE(v.isValid());
+    EXPECT_TRUE(v.isValid(CMD_GET_VERSION));
+    EXPECT_FALSE(v.isValid(CMD_GET_FLAGS));
+    EXPECT_EQ(v.payloadSize(), 4);
+
+    // payload points directly to the frame
+    const GetVersionCmd::data_t *d = v.payloadAs<GetVersionCmd::data_t>();
+    ASSERT_NE(d, nullptr);
+    EXPECT_EQ((const void *)d, (const void *)(frame.data() + 3));
+    EXPECT_EQ(d->fw_version_minor, 0x5);
+    EXPECT_EQ(d->fw_version_major, 0x1);
+
+    // wrong payload type size
+    EXPECT_EQ(v.payloadAs<GetFlagsCmd::data_t>(), nullptr);
+}
+
+TEST(frameViewInvalid, command_handler) {
+    std::vector<uint8_t> badCrc{0xB1,0x5,0x9,0x5,0x1,0x2,0x0,0x17,0xB2};
+    EXPECT_FALSE(FrameView(badCrc.data(), badCrc.size()).isValid());
+
+    std::vector<uint8_t> badLen{0xB1,0x4,0x9,0x5,0x1,0x2,0x0,0x15,0xB2};
+    EXPECT_FALSE(FrameView(badLen.data(), badLen.size()).isValid());
+
+    std::vector<uint8_t> truncated{0xB1,0x5,0x9};
+    EXPECT_FALSE(FrameView(truncated.data(), truncated.size()).isValid());
+    EXPECT_FALSE(FrameView(nullptr, 0).isValid());
+
+    GetVersionCmd cmd;
+    EXPECT_THROW(cmd.deserialize(badCrc.data(), badCrc.size()), std::logic_error);
+    EXPECT_THROW(cmd.deserialize(truncated), std::logic_error);
+}
+
+TEST(deserializeFromBuffer, command_handler) {
+    uint8_t frame[] = {0xB1,0x5,0x9,0x5,0x1,0x2,0x0,0x16,0xB2};
+    GetVersionCmd cmd;
+    cmd.deserialize(frame, sizeof(frame));
+
+    EXPECT_EQ(cmd.getData().fw_pre_release_nr, 0x2);
+
+    const GetVersionCmd::data_t *d = Impl<none, GetVersionCmd::data_t, CMD_GET_VERSION>::payload(FrameView(frame, sizeof(frame)));
+    ASSERT_NE(d, nullptr);
+    EXPECT_EQ(d->fw_pre_release_nr, 0x2);
+}
+
+TEST(packedReportSize, data_types) {
+    EXPECT_EQ(sizeof(Long_Test_Report), 29);
+    EXPECT_EQ(sizeof(Short_Test_Report), 14);
+    EXPECT_EQ(sizeof(GetReportLongCmd::data_t_long), 30);
+    EXPECT_EQ(sizeof(GetReportShortCmd::data_t_short), 15);
+}
+
+TEST(streamParserChunks, stream) {
+    std::vector<uint8_t> version{0xB1,0x5,0x9,0x5,0x1,0x2,0x0,0x16,0xB2};
+    std::vector<uint8_t> stream{0x00, 0xB2, 0x13};
+    stream.insert(stream.end(), version.begin(), version.end());
+    stream.push_back(0x77);
+    stream.insert(stream.end(), version.begin(), version.end());
+
+    FrameStreamParser parser;
+    std::vector<std::vector<uint8_t>> frames;
+    // feed byte by byte
+    for (auto b : stream) {
+        parser.parse(&b, 1, [&](const FrameView &f) {
+            frames.push_back(std::vector<uint8_t>(f.data(), f.data() + f.size()));
+        });
+    }
+
+    ASSERT_EQ(frames.size(), 2);
+    EXPECT_EQ(frames[0], version);
+    EXPECT_EQ(frames[1], version);
+    EXPECT_EQ(parser.dropped(), 4);
+    EXPECT_EQ(parser.available(), 0);
+}
+
+TEST(streamParserResync, stream) {
+    // bad crc frame followed by valid frame, start byte inside the bad frame
+    std::vector<uint8_t> stream{0xB1,0x5,0x9,0xB1,0x1,0x9,0xA,0xB2,0x17,0xB2};
+    FrameStreamParser parser;
+    FrameView f;
+
+    parser.feed(stream.data(), stream.size());
+    ASSERT_TRUE(parser.next(f));
+    EXPECT_TRUE(f.isValid(CMD_GET_VERSION));
+    EXPECT_EQ(f.size(), 5);
+    EXPECT_EQ(parser.rejected(), 1);
+    EXPECT_EQ(parser.stats().count(FRAME_BAD_START_STOP), 1);
+    EXPECT_FALSE(parser.next(f));
+}
+
+TEST(streamParserWrap, stream) {
+    FrameStreamParser parser(512);
+    uint8_t frame[16];
+    GetSettingsCmd cmd;
+    cmd.setPage(3);
+    size_t n = cmd.serialize(frame, sizeof(frame));
+
+    // frames of 10 bytes wrap around the 512 byte ring several times
+    size_t found = 0;
+    for (int i = 0; i < 1000; i++) {
+        found += parser.parse(frame, n, [&](const FrameView &f) {
+            EXPECT_TRUE(f.isValid(CMD_GET_SETTINGS));
+            EXPECT_EQ(f.payload()[4], 3);
+        });
+    }
+    EXPECT_EQ(found, 1000);
+    EXPECT_EQ(parser.frames(), 1000);
+    EXPECT_EQ(parser.rejected(), 0);
+}
+
+TEST(tryDeserializeStatus, command_handler) {
+    GetVersionCmd cmd;
+    FrameStats stats;
+
+    std::vector<uint8_t> ok{0xB1,0x5,0x9,0x5,0x1,0x2,0x0,0x16,0xB2};
+    std::vector<uint8_t> badStart{0xB0,0x5,0x9,0x5,0x1,0x2,0x0,0x16,0xB2};
+    std::vector<uint8_t> badCrc{0xB1,0x5,0x9,0x5,0x1,0x2,0x0,0x17,0xB2};
+    std::vector<uint8_t> badLen{0xB1,0x4,0x9,0x5,0x1,0x2,0x0,0x15,0xB2};
+    std::vector<uint8_t> badId{0xB1,0x5,0xA,0x5,0x1,0x2,0x0,0x17,0xB2};
+
+    EXPECT_EQ(stats.add(cmd.tryDeserialize(ok.data(), ok.size())), FRAME_OK);
+    EXPECT_EQ(stats.add(cmd.tryDeserialize(badStart.data(), badStart.size())), FRAME_BAD_START_STOP);
+    EXPECT_EQ(stats.add(cmd.tryDeserialize(badCrc.data(), badCrc.size())), FRAME_BAD_CRC);
+    EXPECT_EQ(stats.add(cmd.tryDeserialize(badLen.data(), badLen.size())), FRAME_BAD_LENGTH);
+    EXPECT_EQ(stats.add(cmd.tryDeserialize(badId.data(), badId.size())), FRAME_BAD_ID);
+    EXPECT_EQ(stats.add(cmd.tryDeserialize(badId.data(), 3)), FRAME_BAD_LENGTH);
+
+    EXPECT_EQ(stats.total(), 6);
+    EXPECT_EQ(stats.errors(), 5);
+    EXPECT_EQ(stats.count(FRAME_BAD_LENGTH), 2);
+
+    // data of valid frame are kept
+    EXPECT_EQ(cmd.getData().fw_pre_release_nr, 0x2);
+
+    FrameView v(badId.data(), badId.size());
+    EXPECT_EQ(frameStatusMessage(v.status(CMD_GET_VERSION), v, CMD_GET_VERSION), "Invalid ID. Expected:9 received:a");
+}
+
+TEST(compileTimeFrames, command_handler) {
+    static_assert(GetFlagsCmd::impl_type::frame_size == 5, "GetFlags request");
+    static_assert(GetFlagsCmd::impl_type::response_size == 13, "GetFlags response");
+    static_assert(GetReportLongCmd::impl_type::frame_size == 6, "GetReport request");
+    static_assert(GetReportLongCmd::impl_type::response_size == 35, "long report response");
+    static_assert(GetReportShortCmd::impl_type::response_size == 20, "short report response");
+    static_assert(GetSettingsCmd::impl_type::secure_frame_size == 10, "GetSettings request");
+
+    constexpr GetVersionCmd::impl_type::frame_type version = GetVersionCmd::impl_type::requestFrame();
+    static_assert(version[2] == CMD_GET_VERSION && version[3] == 0xA, "GetVersion frame");
+    EXPECT_EQ(std::vector<uint8_t>(version.begin(), version.end()), GetVersionCmd().serialize());
+
+    constexpr auto flags = GetFlagsCmd::impl_type::requestFrame();
+    EXPECT_EQ(std::vector<uint8_t>(flags.begin(), flags.end()), GetFlagsCmd().serialize());
+
+    constexpr auto rtc = ChangeRtcToPresetCmd::impl_type::secureRequestFrame();
+    std::vector<uint8_t> exp{0xB1, 0x5, 23, 9, 227, 224, 23, 0xFF, 0xB2};
+    EXPECT_EQ(std::vector<uint8_t>(rtc.begin(), rtc.end()), exp);
+}
+
+TEST(fixedSizeFrames, command_handler) {
+    GetSettingsCmd::data_send_t page;
+    page.system_settings_page = 1;
+    GetSettingsCmd::impl_type::secure_frame_type f = GetSettingsCmd::impl_type::encodeSecure(page);
+    std::vector<uint8_t> exp{0xB1, 0x6, 15, 9, 227, 228, 15, 1, 0xF5, 0xB2};
+    EXPECT_EQ(std::vector<uint8_t>(f.begin(), f.end()), exp);
+
+    GetReportCmd::data_send_t idx;
+    idx.report_index = 130;
+    auto r = GetReportLongCmd::impl_type::encode(idx);
+    std::vector<uint8_t> expReport{0xB1, 0x2, 24, 130, 156, 0xB2};
+    EXPECT_EQ(std::vector<uint8_t>(r.begin(), r.end()), expReport);
+}
+
+TEST(fusedChecksums, command_handler) {
+    // compare with per-byte definition of crc and security byte
+    std::vector<uint8_t> payload(250);
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = uint8_t(i * 37 + 11);
+    }
+    for (size_t size : {0, 1, 15, 16, 17, 31, 64, 250}) {
+        uint8_t len = uint8_t(size + 1 + 4);
+        uint8_t id = 15;
+        uint32_t crc = len + id + 9 + 227 + id;
+        uint32_t security = 0xFF & ~(len + 1);
+        security += 0xFF & ~(id + 1);
+        for (size_t i = 0; i < size; i++) {
+            crc += payload[i];
+            security += 0xFF & ~(payload[i] + 1);
+        }
+        crc += uint8_t(security);
+
+        FrameCodec::Checksums c = FrameCodec::checksums(len, id, payload.data(), size, true);
+        EXPECT_EQ(c.security, uint8_t(security)) << size;
+        EXPECT_EQ(c.crc, uint8_t(crc)) << size;
+    }
+}
+
+TEST(verifyBatch, command_handler) {
+    uint8_t ok[] = {0xB1,0x5,0x9,0x5,0x1,0x2,0x0,0x16,0xB2};
+    uint8_t bad[] = {0xB1,0x5,0x9,0x5,0x1,0x2,0x0,0x17,0xB2};
+    const uint8_t *frames[] = {ok, bad, ok};
+    size_t sizes[] = {sizeof(ok), sizeof(bad), 4};
+    FrameStatus results[3];
+
+    EXPECT_EQ(FrameCodec::verify(frames, sizes, 3, results), 1);
+    EXPECT_EQ(results[0], FRAME_OK);
+    EXPECT_EQ(results[1], FRAME_BAD_CRC);
+    EXPECT_EQ(results[2], FRAME_BAD_LENGTH);
+}
+
+struct TestResponseHandler {
+    int longReports = 0;
+    int shortReports = 0;
+    int acks = 0;
+    int flags = 0;
+    int others = 0;
+    uint8_t lastIndex = 0;
+
+    void operator()(ResponseOf<GetReportLongCmd>, const GetReportLongCmd::data_t_long &d, const FrameView &) {
+        longReports++;
+        lastIndex = d.index;
+    }
+    void operator()(ResponseOf<GetReportShortCmd>, const GetReportShortCmd::data_t_short &d, const FrameView &) {
+        shortReports++;
+        lastIndex = d.index;
+    }
+    void operator()(ResponseOf<AcknowledgeReportCmd>, const AcknowledgeReportCmd::data_t &, const FrameView &) {
+        acks++;
+    }
+    void operator()(ResponseOf<GetFlagsCmd>, const GetFlagsCmd::data_t &d, const FrameView &) {
+        flags++;
+        EXPECT_EQ(d.error_flags.data, 0x20);
+    }
+    // catch-all
+    template <typename Tag, typename T>
+    void operator()(Tag, const T &, const FrameView &) {
+        others++;
+    }
+};
+
+TEST(dispatchByIdAndLength, dispatch) {
+    TestResponseHandler h;
+    CommandDispatcher<TestResponseHandler> dispatcher(h);
+    uint8_t frame[64];
+
+    GetReportLongCmd::data_t_long longReport;
+    std::memset(static_cast<void *>(&longReport), 0, sizeof(longReport));
+    longReport.index = 130;
+    size_t n = FrameCodec::encode(frame, sizeof(frame), CMD_GET_REPORT, &longReport, sizeof(longReport));
+    EXPECT_EQ(dispatcher.dispatch(frame, n), FRAME_OK);
+
+    GetReportShortCmd::data_t_short shortReport;
+    std::memset(static_cast<void *>(&shortReport), 0, sizeof(shortReport));
+    shortReport.index = 5;
+    n = FrameCodec::encode(frame, sizeof(frame), CMD_GET_REPORT, &shortReport, sizeof(shortReport));
+    EXPECT_EQ(dispatcher.dispatch(frame, n), FRAME_OK);
+    EXPECT_EQ(h.lastIndex, 5);
+
+    AcknowledgeReportCmd::data_t ack;
+    std::memset(static_cast<void *>(&ack), 0, sizeof(ack));
+    n = FrameCodec::encode(frame, sizeof(frame), CMD_ACKNOWLEDGE_REPORT, &ack, sizeof(ack));
+    EXPECT_EQ(dispatcher.dispatch(frame, n), FRAME_OK);
+
+    GetFlagsCmd::data_t flags;
+    std::memset(static_cast<void *>(&flags), 0, sizeof(flags));
+    flags.error_flags.data = 0x20;
+    n = FrameCodec::encode(frame, sizeof(frame), CMD_GET_FLAGS, &flags, sizeof(flags));
+    EXPECT_EQ(dispatcher.dispatch(frame, n), FRAME_OK);
+
+    // version goes to catch-all
+    EXPECT_EQ(dispatcher.dispatch(std::vector<uint8_t>{0xB1,0x5,0x9,0x5,0x1,0x2,0x0,0x16,0xB2}.data(), 9), FRAME_OK);
+
+    EXPECT_EQ(h.longReports, 1);
+    EXPECT_EQ(h.shortReports, 1);
+    EXPECT_EQ(h.acks, 1);
+    EXPECT_EQ(h.flags, 1);
+    EXPECT_EQ(h.others, 1);
+
+    // unknown length for report id, unknown id, broken frame
+    uint8_t twoBytes[2] = {1, 2};
+    n = FrameCodec::encode(frame, sizeof(frame), CMD_GET_REPORT, twoBytes, 2);
+    EXPECT_EQ(dispatcher.dispatch(frame, n), FRAME_BAD_LENGTH);
+    n = FrameCodec::encode(frame, sizeof(frame), 99, twoBytes, 2);
+    EXPECT_EQ(dispatcher.dispatch(frame, n), FRAME_BAD_ID);
+    frame[3]++;
+    EXPECT_EQ(dispatcher.dispatch(frame, n), FRAME_BAD_CRC);
+}
+
+TEST(requestBatch, batch) {
+    RequestBatch batch(16);
+
+    GetReportCmd::data_send_t idx;
+    idx.report_index = 128 + 3;
+    GetSettingsCmd::data_send_t page;
+    page.system_settings_page = 1;
+    GetSettingsCmd settings;
+    settings.setPage(1);
+
+    EXPECT_TRUE(batch.addRequest<GetFlagsCmd>(1));
+    EXPECT_TRUE(batch.addRequest<GetReportLongCmd>(2, idx));
+    EXPECT_TRUE(batch.addRequest<GetSettingsCmd>(3, page, true));
+    EXPECT_TRUE(batch.add(4, settings));
+
+    SetTimeAndDate time;
+    std::tm tm = {};
+    strptime("Wed Jan 12 2022 10:35:34", "%a %b %d %Y %H:%M:%S", &tm);
+    time.setTime(std::chrono::system_clock::from_time_t(std::mktime(&tm)));
+    EXPECT_TRUE(batch.add(5, time));
+
+    ASSERT_EQ(batch.count(), 5);
+    EXPECT_EQ(batch.entry(1).node, 2);
+    EXPECT_EQ(batch.entry(1).id, CMD_GET_REPORT);
+
+    // frames are stored back-to-back
+    std::vector<uint8_t> exp = GetFlagsCmd().serialize();
+    std::vector<uint8_t> r{0xB1, 0x2, 24, 131, 157, 0xB2};
+    exp.insert(exp.end(), r.begin(), r.end());
+    std::vector<uint8_t> s{0xB1, 0x6, 15, 9, 227, 228, 15, 1, 0xF5, 0xB2};
+    exp.insert(exp.end(), s.begin(), s.end());
+    exp.insert(exp.end(), s.begin(), s.end());
+    std::vector<uint8_t> t{0xb1,0x8,0xc,0x22,0x23,0xa,0xb,0x0,0x16,0x14,0x98,0xb2};
+    exp.insert(exp.end(), t.begin(), t.end());
+    EXPECT_EQ(std::vector<uint8_t>(batch.data(), batch.data() + batch.size()), exp);
+
+    EXPECT_EQ(batch.entry(4).offset, exp.size() - t.size());
+    EXPECT_EQ(std::vector<uint8_t>(batch.frame(4), batch.frame(4) + batch.entry(4).size), t);
+
+    // next cycle reuses the arena
+    const uint8_t *arena = batch.data();
+    batch.clear();
+    EXPECT_EQ(batch.size(), 0);
+    EXPECT_TRUE(batch.addRequest<GetFlagsCmd>(1));
+    EXPECT_EQ(batch.data(), arena);
+}
+
+/* transport answering GetReport requests immediately, node has given number of reports
+ * first drop requests are lost, following refuse sends fail
+ */
+class ReportTransport : public Transport {
+public:
+    std::map<NodeAddr, int> reportCount;
+    std::vector<std::pair<NodeAddr, std::vector<uint8_t>>> pending;
+    int sent = 0;
+    int drop = 0;
+    int refuse = 0;
+
+    bool send(NodeAddr node, const uint8_t *data, size_t size) override {
+        if (drop > 0) {
+            drop--;
+            sent++;
+            return true;
+        }
+        if (refuse > 0) {
+            refuse--;
+            return false;
+        }
+        sent++;
+        pending.push_back({node, std::vector<uint8_t>(data, data + size)});
+        return true;
+    }
+
+    size_t receive(Receiver &receiver, std::chrono::microseconds) override {
+        std::vector<std::pair<NodeAddr, std::vector<uint8_t>>> requests;
+        requests.swap(pending);
+        // answer in reverse order
+        for (auto it = requests.rbegin(); it != requests.rend(); ++it) {
+            uint8_t index = it->second[3];
+            int idx = index & 0x7F;
+            GetReportLongCmd::data_t_long r;
+            std::memset(static_cast<void *>(&r), 0, sizeof(r));
+            r.index = idx < reportCount[it->first] ? index : 0xFF;
+            r.rep.end_bottom_cell_volts.data = uint16_t(idx);
+            uint8_t frame[64];
+            size_t n = FrameCodec::encode(frame, sizeof(frame), CMD_GET_REPORT, &r, sizeof(r));
+            receiver.onFrame(it->first, frame, n);
+        }
+        return requests.size();
+    }
+};
+
+TEST(reportDownload, reports) {
+    ReportTransport transport;
+    transport.reportCount[1] = 64;
+    transport.reportCount[2] = 10;
+    transport.reportCount[3] = 0;
+
+    ReportDownloader::Config cfg;
+    cfg.window = 8;
+    ReportDownloader downloader(transport, cfg);
+
+    std::map<NodeAddr, std::set<int>> received;
+    downloader.onLongReport([&](NodeAddr node, const GetReportLongCmd::data_t_long &r) {
+        EXPECT_EQ(r.index.data & 0x7F, r.rep.end_bottom_cell_volts.data);
+        received[node].insert(r.index.data & 0x7F);
+    });
+    downloader.add(1, ReportDownloader::LONG_REPORT);
+    downloader.add(2, ReportDownloader::LONG_REPORT);
+    downloader.add(3, ReportDownloader::LONG_REPORT);
+
+    const ReportDownloader::Stats &stats = downloader.run();
+
+    EXPECT_EQ(received[1].size(), 64);
+    EXPECT_EQ(received[2].size(), 10);
+    EXPECT_EQ(received[3].size(), 0);
+    EXPECT_EQ(stats.reports, 74);
+    EXPECT_EQ(stats.timeouts, 0);
+    // stopped early, only one window after the last report
+    EXPECT_LE(transport.sent, 64 + 10 + cfg.window + cfg.window);
+    EXPECT_GT(stats.reportsPerSecond(), 0);
+}
+
+// short reports are requested with GetReportShort frames
+TEST(reportDownload, shortReports) {
+    DeviceEmulator emulator;
+    DeviceState &state = emulator.add(5);
+    state.short_count = 4;
+    for (int i = 0; i < 4; i++) {
+        state.short_reports[i].bottom_cell_volts.data = uint16_t(100 + i);
+    }
+    SimTransport transport(std::ref(emulator));
+    ReportDownloader downloader(transport);
+    std::set<int> received;
+    downloader.onShortReport([&](NodeAddr, const GetReportShortCmd::data_t_short &r) {
+        EXPECT_EQ(r.index.data, r.rep.bottom_cell_volts.data - 100);
+        received.insert(r.index.data);
+    });
+    downloader.add(5, ReportDownloader::SHORT_REPORT);
+    EXPECT_EQ(downloader.run().reports, 4);
+    EXPECT_EQ(received, std::set<int>({0, 1, 2, 3}));
+}
+
+TEST(reportDownload, busyRetry) {
+    ReportTransport transport;
+    transport.reportCount[1] = 10;
+    // whole first window times out, repeated requests find the transport busy
+    transport.drop = 4;
+    transport.refuse = 3;
+
+    ReportDownloader::Config cfg;
+    cfg.window = 4;
+    cfg.timeout = std::chrono::milliseconds(5);
+    cfg.retries = 1;
+    ReportDownloader downloader(transport, cfg);
+    std::set<int> received;
+    downloader.onLongReport([&](NodeAddr, const GetReportLongCmd::data_t_long &r) {
+        received.insert(r.index.data & 0x7F);
+    });
+    downloader.add(1, ReportDownloader::LONG_REPORT);
+
+    const ReportDownloader::Stats &stats = downloader.run();
+    // refused requests don't use the retry and are not lost
+    EXPECT_EQ(received.size(), 10);
+    EXPECT_EQ(stats.reports, 10);
+    EXPECT_EQ(stats.timeouts, 4);
+    EXPECT_EQ(stats.lost, 0);
+    EXPECT_EQ(transport.refuse, 0);
+}
+
+// every tenth node reports green flags, node 7 doesn't answer
+size_t flagsResponder(NodeAddr node, const uint8_t *request, size_t size, uint8_t *response, size_t capacity) {
+    if (node == 7 || !FrameView(request, size).isValid(CMD_GET_FLAGS)) {
+        return 0;
+    }
+    GetFlagsCmd::data_t flags;
+    std::memset(static_cast<void *>(&flags), 0, sizeof(flags));
+    flags.info_flags.data = node % 10 == 0 ? 0x1 : 0;
+    return FrameCodec::encode(response, capacity, CMD_GET_FLAGS, &flags, sizeof(flags));
+}
+
+TEST(flagsPoller, poller) {
+    SimTransport::Config simCfg;
+    simCfg.max_in_flight = 32;
+    SimTransport transport(flagsResponder, simCfg);
+
+    FlagsPoller::Config cfg;
+    cfg.initial_concurrency = 4;
+    cfg.max_concurrency = 64;
+    cfg.timeout = std::chrono::milliseconds(20);
+    cfg.quiet_interval = 2;
+    FlagsPoller poller(transport, cfg);
+
+    std::vector<NodeAddr> polled;
+    poller.onFlags([&](NodeAddr node, const GetFlagsCmd::data_t &) {
+        polled.push_back(node);
+    });
+    for (NodeAddr node = 1; node <= 1000; node++) {
+        poller.addNode(node);
+    }
+
+    // all nodes in the first cycle
+    poller.runCycle();
+    EXPECT_EQ(polled.size(), 999);
+    EXPECT_EQ(poller.stats().timeouts, 1);
+    EXPECT_TRUE(poller.isActive(10));
+    EXPECT_FALSE(poller.isActive(11));
+
+    // only active nodes in the second cycle
+    polled.clear();
+    poller.runCycle();
+    EXPECT_EQ(polled.size(), 100);
+    for (NodeAddr node : polled) {
+        EXPECT_EQ(node % 10, 0);
+    }
+
+    // active nodes are polled ahead of quiet ones
+    polled.clear();
+    poller.runCycle();
+    EXPECT_EQ(polled.size(), 999);
+    for (size_t i = 0; i < 100; i++) {
+        EXPECT_EQ(polled[i] % 10, 0);
+    }
+
+    const FlagsPoller::Stats &stats = poller.stats();
+    EXPECT_EQ(stats.cycles, 3);
+    EXPECT_EQ(stats.polls, 999 + 100 + 999);
+    EXPECT_EQ(stats.timeouts, 2);
+    EXPECT_GT(stats.pollsPerSecond(), 0);
+    EXPECT_GE(stats.cycleTime(99), stats.cycleTime(50));
+    // concurrency grows with fast responses, limited by the transport
+    EXPECT_GT(poller.concurrency(), cfg.initial_concurrency);
+    EXPECT_LE(poller.concurrency(), cfg.max_concurrency);
+}
+
+// transport with the link down, every send fails
+class DownTransport : public Transport {
+public:
+    int sends = 0;
+
+    bool send(NodeAddr, const uint8_t *, size_t) override {
+        sends++;
+        return false;
+    }
+
+    size_t receive(Receiver &, std::chrono::microseconds timeout) override {
+        std::this_thread::sleep_for(timeout);
+        return 0;
+    }
+};
+
+// cycle ends after timeout when the transport takes nothing
+TEST(flagsPollerLinkDown, poller) {
+    DownTransport transport;
+    FlagsPoller::Config cfg;
+    cfg.timeout = std::chrono::milliseconds(5);
+    FlagsPoller poller(transport, cfg);
+    for (NodeAddr node = 1; node <= 10; node++) {
+        poller.addNode(node);
+    }
+    auto duration = poller.runCycle();
+    EXPECT_GE(duration, cfg.timeout);
+    EXPECT_LT(duration, std::chrono::milliseconds(500));
+    EXPECT_EQ(poller.stats().errors, 10);
+    EXPECT_EQ(poller.stats().polls, 0);
+    // back off instead of busy spinning
+    EXPECT_LT(transport.sends, 10);
+}
+
+// percentiles of the last cycle_window cycles, older cycle times are overwritten
+TEST(flagsPollerCycleTimes, poller) {
+    SimTransport transport(flagsResponder);
+    FlagsPoller poller(transport);
+    poller.addNode(1);
+    for (size_t i = 0; i < FlagsPoller::Stats::cycle_window + 10; i++) {
+        poller.runCycle();
+    }
+    const FlagsPoller::Stats &stats = poller.stats();
+    EXPECT_EQ(stats.cycles, FlagsPoller::Stats::cycle_window + 10);
+    EXPECT_GT(stats.cycleTime(0).count(), 0);
+    EXPECT_LE(stats.cycleTime(0), stats.cycleTime(50));
+    EXPECT_LE(stats.cycleTime(50), stats.cycleTime(100));
+    EXPECT_LE(stats.cycleTime(100), stats.elapsed);
+}
+
+TEST(deviceEmulator, emulator) {
+    DeviceEmulator emulator;
+    DeviceState &state = emulator.add(5);
+    state.version.fw_version_minor = 7;
+    state.flags.error_flags.data = 0x4;
+    state.settings[1].power_maintained_mode.data = 1234;
+    state.long_count = 3;
+    for (int i = 0; i < 3; i++) {
+        state.long_reports[i].end_bottom_cell_volts.data = uint16_t(i);
+    }
+    uint8_t request[64];
+    uint8_t response[SimTransport::max_frame_size];
+
+    GetVersionCmd version;
+    size_t n = emulator.respond(5, request, version.serialize(request, sizeof(request)), response, sizeof(response));
+    version.deserialize(response, n);
+    EXPECT_EQ(version.getData().fw_version_minor, 7);
+    EXPECT_EQ(version.getData().fw_version_major, 1);
+
+    GetSettingsCmd settings;
+    settings.setPage(1);
+    n = emulator.respond(5, request, settings.serialize(request, sizeof(request)), response, sizeof(response));
+    EXPECT_EQ(settings.tryDeserialize(response, n), FRAME_OK);
+    EXPECT_EQ(settings.getData().page.power_maintained_mode.data, 1234);
+
+    GetFlagsCmd flags;
+    n = emulator.respond(5, request, flags.serialize(request, sizeof(request)), response, sizeof(response));
+    flags.deserialize(response, n);
+    EXPECT_EQ(flags.getData().error_flags.data, 0x4);
+
+    ResetFlagsCmd reset;
+    n = emulator.respond(5, request, reset.serialize(request, sizeof(request)), response, sizeof(response));
+    EXPECT_EQ(reset.tryDeserialize(response, n), FRAME_OK);
+    EXPECT_EQ(state.flags.error_flags.data, 0);
+
+    // unknown node doesn't answer
+    EXPECT_EQ(emulator.respond(6, request, flags.serialize(request, sizeof(request)), response, sizeof(response)), 0);
+
+    // reports downloaded through the simulated transport
+    SimTransport transport(std::ref(emulator));
+    ReportDownloader downloader(transport);
+    std::set<int> received;
+    downloader.onLongReport([&](NodeAddr, const GetReportLongCmd::data_t_long &r) {
+        received.insert(r.rep.end_bottom_cell_volts.data);
+    });
+    downloader.add(5, ReportDownloader::LONG_REPORT);
+    EXPECT_EQ(downloader.run().reports, 3);
+    EXPECT_EQ(received, std::set<int>({0, 1, 2}));
+}
+
+// device in acknowledge mode answers the report request with its green and red flags
+TEST(deviceEmulatorAck, emulator) {
+    DeviceEmulator emulator;
+    DeviceState &state = emulator.add(5);
+    state.ack_reports = true;
+    state.long_count = 1;
+    // long and short pass reports available, short test failed
+    state.flags.info_flags.data = 0x3;
+    state.flags.error_flags.data = 0x4;
+    uint8_t request[64];
+    uint8_t response[SimTransport::max_frame_size];
+
+    AcknowledgeReport ack;
+    ack.ackLongTest(0);
+    size_t n = emulator.respond(5, request, ack.serialize(request, sizeof(request)), response, sizeof(response));
+    ASSERT_EQ(n, FrameCodec::frameSize(AcknowledgeReportCmd::impl_type::recv_payload_size));
+    EXPECT_EQ(ack.tryDeserialize(response, n), FRAME_OK);
+    // long report is acknowledged, short one is still available
+    EXPECT_EQ(ack.getData().green_flags.data.data, 0x2);
+    EXPECT_EQ(ack.getData().red_flags.data.data, 0x4);
+    EXPECT_EQ(state.flags.info_flags.data, 0x2);
+
+    // report response in the default mode
+    state.ack_reports = false;
+    GetReportCmd::data_send_t index;
+    index.report_index = 128;
+    GetReportLongCmd::impl_type::frame_type frame = GetReportLongCmd::impl_type::encode(index);
+    n = emulator.respond(5, frame.data(), frame.size(), response, sizeof(response));
+    EXPECT_EQ(n, FrameCodec::frameSize(GetReportLongCmd::impl_type::recv_payload_size));
+}
+
+TEST(deviceEmulatorErrors, emulator) {
+    DeviceEmulator::Config cfg;
+    cfg.drop_rate = 0.25;
+    cfg.corrupt_rate = 0.25;
+    DeviceEmulator emulator(cfg);
+    emulator.reserve(10000);
+    for (NodeAddr node = 0; node < 10000; node++) {
+        emulator.add(node);
+    }
+    EXPECT_EQ(emulator.size(), 10000);
+
+    static constexpr GetFlagsCmd::impl_type::frame_type request = GetFlagsCmd::impl_type::requestFrame();
+    uint8_t response[SimTransport::max_frame_size];
+    size_t valid = 0;
+    for (NodeAddr node = 0; node < 10000; node++) {
+        size_t n = emulator.respond(node, request.data(), request.size(), response, sizeof(response));
+        valid += n > 0 && FrameView(response, n).isValid(CMD_GET_FLAGS);
+    }
+    const DeviceEmulator::Stats &stats = emulator.stats();
+    EXPECT_EQ(stats.requests, 10000);
+    EXPECT_EQ(stats.responses + stats.dropped, 10000);
+    EXPECT_EQ(valid, stats.responses - stats.corrupted);
+    EXPECT_NEAR(double(stats.dropped) / stats.requests, 0.25, 0.03);
+    EXPECT_NEAR(double(stats.corrupted) / stats.responses, 0.25, 0.03);
+}
+
+TEST(columnScan, reports) {
+    // odd sizes exercise both vector and scalar loops
+    for (size_t size : {0u, 7u, 100u, 1001u}) {
+        std::vector<uint16_t> v16(size);
+        std::vector<uint8_t> v8(size);
+        for (size_t i = 0; i < size; i++) {
+            v16[i] = uint16_t(i * 7919 % 65536);
+            v8[i] = uint8_t(i * 31 % 256);
+        }
+        ColumnSummary s16 = ColumnScan::summary(v16.data(), size);
+        ColumnSummary s8 = ColumnScan::summary(v8.data(), size);
+        EXPECT_EQ(s16.count, size);
+        if (size > 0) {
+            EXPECT_EQ(s16.min, *std::min_element(v16.begin(), v16.end()));
+            EXPECT_EQ(s16.max, *std::max_element(v16.begin(), v16.end()));
+            EXPECT_DOUBLE_EQ(s16.mean, std::accumulate(v16.begin(), v16.end(), 0.0) / size);
+            EXPECT_EQ(s8.min, *std::min_element(v8.begin(), v8.end()));
+            EXPECT_EQ(s8.max, *std::max_element(v8.begin(), v8.end()));
+            EXPECT_DOUBLE_EQ(s8.mean, std::accumulate(v8.begin(), v8.end(), 0.0) / size);
+        }
+        for (uint16_t t : {0, 1000, 40000, 65535}) {
+            EXPECT_EQ(ColumnScan::countAbove(v16.data(), size, t), size_t(std::count_if(v16.begin(), v16.end(), [t](uint16_t x) { return x > t; })));
+            EXPECT_EQ(ColumnScan::countBelow(v16.data(), size, t), size_t(std::count_if(v16.begin(), v16.end(), [t](uint16_t x) { return x < t; })));
+        }
+        for (uint8_t t : {0, 100, 200, 255}) {
+            EXPECT_EQ(ColumnScan::countAbove(v8.data(), size, t), size_t(std::count_if(v8.begin(), v8.end(), [t](uint8_t x) { return x > t; })));
+        }
+    }
+}
+
+TEST(longReportStore, reports) {
+    LongReportStore store;
+    GetReportLongCmd::data_t_long r;
+    std::memset(static_cast<void *>(&r), 0, sizeof(r));
+    for (int i = 0; i < 10; i++) {
+        r.index = uint8_t(i + 128);
+        r.rep.end_bottom_cell_volts.data = uint16_t(3000 + i * 100);
+        r.rep.bot_cell_amp_hours.data = uint16_t(i);
+        r.rep.end_load_current = uint8_t(i * 2);
+        EXPECT_TRUE(store.append(NodeAddr(i % 3), r));
+    }
+    r.index = 0xFF;
+    EXPECT_FALSE(store.append(1, r));
+    EXPECT_EQ(store.size(), 10);
+
+    ColumnSummary volts = store.summary(LongReportStore::END_BOTTOM_CELL_VOLTS);
+    EXPECT_EQ(volts.min, 3000);
+    EXPECT_EQ(volts.max, 3900);
+    EXPECT_DOUBLE_EQ(volts.mean, 3450);
+    EXPECT_EQ(store.summary(LongReportStore::END_LOAD_CURRENT).max, 18);
+    EXPECT_EQ(store.countBelow(LongReportStore::END_BOTTOM_CELL_VOLTS, 3200), 2);
+    EXPECT_EQ(store.countAbove(LongReportStore::END_LOAD_CURRENT, 10), 4);
+
+    std::vector<uint32_t> rows = store.selectAbove(LongReportStore::END_BOTTOM_CELL_VOLTS, 3700);
+    EXPECT_EQ(rows, std::vector<uint32_t>({8, 9}));
+    EXPECT_EQ(store.nodes()[rows[0]], 2);
+    EXPECT_EQ(store.column(LongReportStore::BOT_CELL_AMP_HOURS)[rows[1]], 9);
+}
+
+TEST(jsonEncoder, provider) {
+    JsonEncoder encoder;
+    GetVersion::Version v{2, 1, 0, 3};
+    EXPECT_STREQ(encoder.encode(v), "{\"minor\":2,\"major\":1,\"release\":0,\"variant\":3}");
+
+    // buffer is reused for next object
+    GetFlags flags;
+    GetFlagsCmd::data_t d;
+    std::memset(static_cast<void *>(&d), 0, sizeof(d));
+    d.info_flags.data = 5;
+    d.error_flags.data = 2;
+    uint8_t frame[32];
+    flags.deserialize(frame, FrameCodec::encode(frame, sizeof(frame), CMD_GET_FLAGS, &d, sizeof(d)));
+    EXPECT_STREQ(encoder.encode(flags.getFlags()), "{\"green\":5,\"yellow\":0,\"red\":2,\"systemStatus\":0,\"additionalStatus\":0}");
+    EXPECT_EQ(encoder.size(), std::strlen(encoder.str()));
+
+    // DOM encoder has the same members
+    rapidjson::Document doc;
+    rapidjson::Value val = v.encode(doc.GetAllocator());
+    EXPECT_EQ(val["major"].GetInt(), 1);
+    EXPECT_EQ(val["variant"].GetInt(), 3);
+}
+
+TEST(jsonEncoderReports, provider) {
+    GetReportLong longReport;
+    GetReportLongCmd::data_t_long l;
+    std::memset(static_cast<void *>(&l), 0, sizeof(l));
+    l.index = 130;
+    l.rep.end_bottom_cell_volts.data = 3300;
+    l.rep.start_load_volts = 12;
+    uint8_t frame[64];
+    longReport.deserialize(frame, FrameCodec::encode(frame, sizeof(frame), CMD_GET_REPORT, &l, sizeof(l)));
+    GetReportLong::LongReport lr = longReport.getReport();
+    EXPECT_EQ(lr.endBottomVolts, 3300);
+    EXPECT_EQ(lr.startLoadVolts, 12);
+
+    JsonEncoder encoder;
+    std::string json = encoder.encode(lr);
+    EXPECT_NE(json.find("\"endBottomVolts\":3300"), std::string::npos);
+    EXPECT_NE(json.find("\"startLoadVolts\":12"), std::string::npos);
+    EXPECT_NE(json.find("\"testFlags\":0}"), std::string::npos);
+
+    GetReportShort shortReport;
+    GetReportShortCmd::data_t_short sr;
+    std::memset(static_cast<void *>(&sr), 0, sizeof(sr));
+    sr.index = 1;
+    sr.rep.load_current.data = 250;
+    shortReport.deserialize(frame, FrameCodec::encode(frame, sizeof(frame), CMD_GET_REPORT, &sr, sizeof(sr)));
+    json = encoder.encode(shortReport.getShortReport());
+    EXPECT_NE(json.find("\"loadCurrent\":250"), std::string::npos);
+
+    // settings page
+    GetSettings settings;
+    GetSettingsCmd::data_t page;
+    std::memset(static_cast<void *>(&page), 0, sizeof(page));
+    page.system_settings_page = 1;
+    page.page.test_voltage_upper_limit.data = 4000;
+    settings.deserialize(frame, FrameCodec::encode(frame, sizeof(frame), CMD_GET_SETTINGS, &page, sizeof(page)));
+    json = encoder.encode(settings.getSettings());
+    EXPECT_NE(json.find("\"page\":1"), std::string::npos);
+    EXPECT_NE(json.find("\"testVoltageUpperLimit\":4000}"), std::string::npos);
+}
+
+TEST(civilTime, time) {
+    EXPECT_EQ(CivilTime::daysFromCivil(1970, 1, 1), 0);
+    EXPECT_EQ(CivilTime::daysFromCivil(2000, 3, 1), 11017);
+    EXPECT_EQ(CivilTime::daysFromCivil(1969, 12, 31), -1);
+    static_assert(CivilTime::daysFromCivil(2022, 1, 12) == 19004, "compile-time conversion");
+    // 2022-01-12 is Wednesday
+    EXPECT_EQ(CivilTime::weekdayFromDays(19004), 3);
+    EXPECT_EQ(CivilTime::weekdayFromDays(-1), 3);
+
+    for (int64_t days = -800000; days < 800000; days += 997) {
+        CivilDate d = CivilTime::civilFromDays(days);
+        EXPECT_EQ(CivilTime::daysFromCivil(d.year, d.month, d.day), days);
+    }
+    // same as C library in UTC
+    for (int64_t t = 0; t < 4000000000; t += 86400 * 37 + 3671) {
+        time_t tt = time_t(t);
+        tm u;
+        gmtime_r(&tt, &u);
+        CivilDate d = CivilTime::civilFromDays(CivilTime::daysFromSeconds(t));
+        EXPECT_EQ(d.year, u.tm_year + 1900);
+        EXPECT_EQ(d.month, unsigned(u.tm_mon + 1));
+        EXPECT_EQ(d.day, unsigned(u.tm_mday));
+    }
+}
+
+TEST(timeZoneFixed, time) {
+    GetTimeAndDate::data_recv_t t;
+    t.time_second = 34;
+    t.time_minute = 35;
+    t.time_hour = 10;
+    t.date_day = 11;
+    t.date_month = 0;
+    t.date_year = 22;
+    t.date_century = 20;
+
+    TimeZone cet = TimeZone::fixed(std::chrono::hours(1));
+    auto tp = DateTimeBase::convertToTimePoint(t, cet);
+    // 2022-01-12 09:35:34 UTC
+    EXPECT_EQ(std::chrono::system_clock::to_time_t(tp), 1641980134);
+
+    DateTimeBase::data_send_t s = DateTimeBase::convertFromTimePoint(tp, cet);
+    EXPECT_EQ(s.time_hour, 10);
+    EXPECT_EQ(s.time_minute, 35);
+    EXPECT_EQ(s.time_second, 34);
+    EXPECT_EQ(s.date_day, 11);
+    EXPECT_EQ(s.date_month, 0);
+    EXPECT_EQ(s.date_year, 22);
+    EXPECT_EQ(s.date_century, 20);
+
+    // day overflow is normalised
+    t.date_day = 31;
+    EXPECT_EQ(std::chrono::system_clock::to_time_t(DateTimeBase::convertToTimePoint(t, TimeZone::utc())), 1641980134 + 3600 + 20 * 86400);
+}
+
+// compare local zone with mktime()/localtime_r() in zone with DST
+TEST(timeZoneLocal, time) {
+    const char *old = std::getenv("TZ");
+    std::string saved = old ? old : "";
+    setenv("TZ", "Europe/Prague", 1);
+    tzset();
+    TimeZone::resetLocal();
+
+    TimeZone local = TimeZone::local();
+    for (int64_t t = 1600000000; t < 1700000000; t += 3600 * 7 + 13) {
+        time_t tt = time_t(t);
+        tm l;
+        localtime_r(&tt, &l);
+        DateTimeBase::data_send_t s = DateTimeBase::convertFromTimePoint(std::chrono::system_clock::from_time_t(tt));
+        ASSERT_EQ(s.time_hour, l.tm_hour);
+        ASSERT_EQ(s.date_day, l.tm_mday - 1);
+
+        tm m = l;
+        m.tm_isdst = -1;
+        ASSERT_EQ(local.toUtc(local.toLocal(t)), int64_t(mktime(&m)));
+    }
+    // 2021-03-28 02:30 doesn't exist, 2021-10-31 02:30 is repeated
+    int64_t gap = CivilTime::daysFromCivil(2021, 3, 28) * 86400 + 2 * 3600 + 1800;
+    EXPECT_EQ(local.toLocal(local.toUtc(gap)), gap + 3600);
+    int64_t repeated = CivilTime::daysFromCivil(2021, 10, 31) * 86400 + 2 * 3600 + 1800;
+    EXPECT_EQ(local.toUtc(repeated), repeated - 7200);
+
+    if (old) {
+        setenv("TZ", saved.c_str(), 1);
+    } else {
+        unsetenv("TZ");
+    }
+    tzset();
+    TimeZone::resetLocal();
+}
+
+// concurrent conversions give the same results as serial ones
+TEST(timeZoneThreads, time) {
+    auto convert = [](int64_t t) {
+        auto tp = std::chrono::system_clock::from_time_t(time_t(t));
+        DateTimeBase::data_send_t s = DateTimeBase::convertFromTimePoint(tp);
+        DateTimeBase::data_recv_t r;
+        r.time_second = s.time_second;
+        r.time_minute = s.time_minute;
+        r.time_hour = s.time_hour;
+        r.date_day = s.date_day;
+        r.date_month = s.date_month;
+        r.date_year = s.date_year;
+        r.date_century = s.date_century;
+        return std::chrono::system_clock::to_time_t(DateTimeBase::convertToTimePoint(r));
+    };
+    const int64_t begin = 1600000000;
+    const int64_t step = 3593;
+    std::vector<time_t> expected;
+    for (int64_t t = begin; t < begin + 86400 * 400; t += step) {
+        expected.push_back(convert(t));
+    }
+
+    TimeZone::resetLocal();
+    std::vector<std::thread> threads;
+    std::atomic<int> errors(0);
+    for (int n = 0; n < 4; n++) {
+        threads.emplace_back([&]() {
+            for (size_t i = 0; i < expected.size(); i++) {
+                if (convert(begin + int64_t(i) * step) != expected[i]) {
+                    errors++;
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(errors, 0);
+}
+
+// batch decode agrees with convertToTimePoint() for every year and month including overflow
+TEST(compressedDateTime, time) {
+    std::vector<uint16_t> dates;
+    std::vector<uint16_t> times;
+    std::vector<int64_t> expected;
+    TimeZone cet = TimeZone::fixed(std::chrono::hours(1));
+    for (uint32_t y = 0; y <= 99; y++) {
+        for (uint32_t m = 0; m < 16; m++) {
+            for (uint32_t d = 0; d < 32; d += 7) {
+                System_Compressed_Date cd;
+                cd.set_year(y);
+                cd.set_month(m);
+                cd.set_day_of_month(d);
+                System_Compressed_Time ct;
+                ct.set_hours((y + d) % 24);
+                ct.set_minute(m * 3);
+                ct.set_seconds(29);
+                dates.push_back(cd.data.data);
+                times.push_back(ct.data.data);
+
+                DateTimeBase::data_recv_t r;
+                r.date_year = int(y);
+                r.date_month = int(m);
+                r.date_day = int(d);
+                r.date_century = 20;
+                r.time_hour = int((y + d) % 24);
+                r.time_minute = int(m * 3);
+                r.time_second = 58;
+                expected.push_back(std::chrono::system_clock::to_time_t(DateTimeBase::convertToTimePoint(r, cet)));
+                ASSERT_EQ(CompressedDateTime::toSeconds(cd, ct, cet), expected.back());
+            }
+        }
+    }
+    std::vector<int64_t> seconds(dates.size());
+    CompressedDateTime::toSeconds(dates.data(), times.data(), dates.size(), seconds.data(), cet);
+    EXPECT_EQ(seconds, expected);
+
+    // 2022-01-12 10:35:34
+    System_Compressed_Date cd;
+    cd.set_year(22);
+    cd.set_day_of_month(11);
+    System_Compressed_Time ct;
+    ct.set_hours(10);
+    ct.set_minute(35);
+    ct.set_seconds(17);
+    EXPECT_EQ(CompressedDateTime::toSeconds(cd, ct, TimeZone::utc()), 1641983734);
+    EXPECT_EQ(CompressedDateTime::toSeconds(cd, ct, TimeZone::utc(), 19), 1641983734 - int64_t(CivilTime::daysFromCivil(2022, 1, 1) - CivilTime::daysFromCivil(1922, 1, 1)) * 86400);
+    EXPECT_THROW(CompressedDateTime::localSeconds(cd.data.data, ct.data.data, 100), std::logic_error);
+}
+
+// batch in local zone with DST gives the same result as single conversions
+TEST(compressedDateTimeLocal, time) {
+    const char *old = std::getenv("TZ");
+    std::string saved = old ? old : "";
+    setenv("TZ", "Europe/Prague", 1);
+    tzset();
+    TimeZone::resetLocal();
+
+    std::vector<Long_Test_Report> reports(2000);
+    std::vector<int64_t> expected;
+    for (size_t i = 0; i < reports.size(); i++) {
+        // reports every 4.5 hours through 2021
+        int64_t local = CivilTime::daysFromCivil(2021, 1, 1) * 86400 + int64_t(i) * 16200;
+        int64_t days = CivilTime::daysFromSeconds(local);
+        CivilDate date = CivilTime::civilFromDays(days);
+        int64_t secs = local - days * 86400;
+        Long_Test_Report &r = reports[i];
+        std::memset(static_cast<void *>(&r), 0, sizeof(r));
+        r.start_date.set_year(uint32_t(date.year % 100));
+        r.start_date.set_month(date.month - 1);
+        r.start_date.set_day_of_month(date.day - 1);
+        r.start_time.set_hours(uint32_t(secs / 3600));
+        r.start_time.set_minute(uint32_t(secs / 60 % 60));
+        expected.push_back(CompressedDateTime::toSeconds(r.start_date, r.start_time));
+    }
+    std::vector<int64_t> seconds(reports.size());
+    CompressedDateTime::startSeconds(reports.data(), reports.size(), seconds.data());
+    EXPECT_EQ(seconds, expected);
+
+    LongReportStore store;
+    for (const auto &r : reports) {
+        store.append(1, r);
+    }
+    EXPECT_EQ(store.startSeconds(), expected);
+    // 2021-09-28 00:00 is CEST
+    EXPECT_EQ(expected[1440], CivilTime::daysFromCivil(2021, 1, 1) * 86400 + 1440 * 16200 - 7200);
+
+    if (old) {
+        setenv("TZ", saved.c_str(), 1);
+    } else {
+        unsetenv("TZ");
+    }
+    tzset();
+    TimeZone::resetLocal();
+}
+
+// getter reads only its own bit
+TEST(flags16, bits) {
+    for (int i = 0; i < 16; i++) {
+        FLAGS16 f;
+        f.data = uint16_t(1 << i);
+        RedFlags red;
+        red.data = f;
+        EXPECT_EQ(red.rtc_not_running(), i == 0);
+        EXPECT_EQ(red.long_test_failed(), i == 1);
+        EXPECT_EQ(red.short_test_failed(), i == 2);
+        EXPECT_EQ(red.led_over_current_trip(), i == 5);
+        EXPECT_EQ(f.f15(), i == 15);
+    }
+}
+
+TEST(flagIndex, query) {
+    FlagIndex index;
+    GetFlagsCmd::data_t flags;
+    std::memset(static_cast<void *>(&flags), 0, sizeof(flags));
+
+    flags.error_flags.setf5(true);
+    index.update(3, flags);
+    flags.error_flags.setf0(true);
+    index.update(200, flags);
+    flags.error_flags.data = 0;
+    flags.warning_flags.setf2(true);
+    index.update(64, flags);
+
+    EXPECT_EQ(index.size(), 3);
+    EXPECT_EQ(index.count(FlagIndex::LED_OVER_CURRENT_TRIP), 2);
+    EXPECT_EQ(index.nodes(FlagIndex::LED_OVER_CURRENT_TRIP), (std::vector<NodeAddr>{3, 200}));
+    EXPECT_EQ(index.nodes(FlagIndex::RTC_NOT_RUNNING), (std::vector<NodeAddr>{200}));
+    EXPECT_TRUE(index.has(64, FlagIndex::BAD_TIME_SYNC));
+    EXPECT_FALSE(index.has(65, FlagIndex::BAD_TIME_SYNC));
+    EXPECT_STREQ(FlagIndex::name(FlagIndex::LED_OVER_CURRENT_TRIP), "led_over_current_trip");
+
+    auto q = FlagIndex::Query().all(FlagIndex::LED_OVER_CURRENT_TRIP).none(FlagIndex::RTC_NOT_RUNNING);
+    EXPECT_EQ(index.select(q), (std::vector<NodeAddr>{3}));
+    EXPECT_EQ(index.select(FlagIndex::Query().anyOf(FlagIndex::red_mask | FlagIndex::yellow_mask)), (std::vector<NodeAddr>{3, 64, 200}));
+    EXPECT_EQ(index.select(FlagIndex::Query().noneOf(FlagIndex::red_mask)), (std::vector<NodeAddr>{64}));
+
+    // cleared flag leaves the bitmap, removed node doesn't match even empty predicate
+    flags.warning_flags.data = 0;
+    index.update(64, flags);
+    EXPECT_EQ(index.count(FlagIndex::BAD_TIME_SYNC), 0);
+    index.remove(200);
+    EXPECT_EQ(index.count(FlagIndex::Query()), 2);
+    EXPECT_EQ(index.count(FlagIndex::RTC_NOT_RUNNING), 0);
+}
+
+// compound queries agree with predicate evaluated on every node
+TEST(flagIndex, random) {
+    std::mt19937 random(5);
+    FlagIndex index;
+    std::map<NodeAddr, uint64_t> state;
+    for (int i = 0; i < 20000; i++) {
+        NodeAddr node = NodeAddr(random() % 3000);
+        // sparse flags
+        uint64_t flags = uint64_t(random()) << 32 | random();
+        flags &= uint64_t(random()) << 32 | random();
+        flags &= uint64_t(random()) << 32 | random();
+        index.update(node, flags);
+        state[node] = flags;
+    }
+    std::vector<FlagIndex::Query> queries{
+        FlagIndex::Query().all(FlagIndex::LED_OVER_CURRENT_TRIP),
+        FlagIndex::Query().all(FlagIndex::RTC_NOT_RUNNING).any(FlagIndex::MAINS_ON).any(FlagIndex::PSU_UP),
+        FlagIndex::Query().anyOf(FlagIndex::red_mask).none(FlagIndex::CELLS_ENABLED),
+        FlagIndex::Query().noneOf(FlagIndex::green_mask),
+    };
+    for (const auto &q : queries) {
+        std::vector<NodeAddr> expected;
+        for (const auto &s : state) {
+            if (q.matches(s.second)) {
+                expected.push_back(s.first);
+            }
+        }
+        EXPECT_EQ(index.select(q), expected);
+        EXPECT_EQ(index.count(q), expected.size());
+    }
+}
+
+// polls of fresh entries are skipped, identical responses are reported unchanged
+TEST(deviceStateCache, cache) {
+    DeviceEmulator emulator;
+    DeviceState &state = emulator.add(5);
+    state.version.fw_version_minor = 7;
+    uint8_t request[64];
+    uint8_t response[SimTransport::max_frame_size];
+
+    DeviceStateCache cache(std::chrono::seconds(10));
+    cache.setTtl<GetVersionCmd>(std::chrono::hours(24));
+    auto now = DeviceStateCache::clock::now();
+
+    auto poll = [&](NodeAddr node, size_t size, uint8_t selector) {
+        size_t n = emulator.respond(node, request, size, response, sizeof(response));
+        return cache.update(node, FrameView(response, n), selector, now);
+    };
+    GetVersionCmd version;
+    GetSettingsCmd settings;
+    GetFlagsCmd flags;
+
+    EXPECT_FALSE(cache.isFresh<GetVersionCmd>(5, 0, now));
+    EXPECT_EQ(poll(5, version.serialize(request, sizeof(request)), 0), DeviceStateCache::NEW);
+    for (uint8_t page = 0; page < 2; page++) {
+        settings.setPage(page);
+        EXPECT_EQ(poll(5, settings.serialize(request, sizeof(request)), page), DeviceStateCache::NEW);
+    }
+    EXPECT_EQ(poll(5, flags.serialize(request, sizeof(request)), 0), DeviceStateCache::NEW);
+    EXPECT_EQ(cache.size(), 4);
+
+    GetVersionCmd::data_t v;
+    ASSERT_TRUE(cache.get<GetVersionCmd>(5, v));
+    EXPECT_EQ(v.fw_version_minor, 7);
+    GetFlagsCmd::data_t f;
+    EXPECT_FALSE(cache.get<GetFlagsCmd>(6, f));
+
+    // flags expire after 10 s, version after a day
+    now += std::chrono::seconds(11);
+    EXPECT_TRUE(cache.isFresh<GetVersionCmd>(5, 0, now));
+    EXPECT_FALSE(cache.isFresh<GetFlagsCmd>(5, 0, now));
+    EXPECT_FALSE(cache.isFresh<GetSettingsCmd>(5, 1, now));
+    auto first_change = cache.changed(5, CMD_GET_FLAGS);
+    EXPECT_EQ(poll(5, flags.serialize(request, sizeof(request)), 0), DeviceStateCache::UNCHANGED);
+    EXPECT_TRUE(cache.isFresh<GetFlagsCmd>(5, 0, now));
+    EXPECT_EQ(cache.changed(5, CMD_GET_FLAGS), first_change);
+
+    now += std::chrono::seconds(11);
+    state.flags.error_flags.setf5(true);
+    EXPECT_EQ(poll(5, flags.serialize(request, sizeof(request)), 0), DeviceStateCache::CHANGED);
+    ASSERT_TRUE(cache.get<GetFlagsCmd>(5, f));
+    EXPECT_TRUE(f.error_flags.f5());
+    EXPECT_EQ(cache.changed(5, CMD_GET_FLAGS), now);
+
+    EXPECT_EQ(cache.update(5, FrameView(response, 3)), DeviceStateCache::INVALID);
+    cache.invalidate(5, CMD_GET_VERSION);
+    EXPECT_FALSE(cache.isFresh<GetVersionCmd>(5, 0, now));
+    cache.invalidate(5);
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(cache.stats().unchanged, 1);
+    EXPECT_EQ(cache.stats().changed, 5);
+}
+
+// only flipped bits produce events
+TEST(flagEventStream, events) {
+    FlagEventStream stream;
+    std::vector<std::string> events;
+    stream.onEvent([&](const FlagEvent &e) {
+        events.push_back(e.toString());
+    });
+    GetFlagsCmd::data_t flags;
+    std::memset(static_cast<void *>(&flags), 0, sizeof(flags));
+
+    flags.error_flags.setf2(true);
+    EXPECT_EQ(stream.update(417, flags), 1);
+    EXPECT_EQ(events, std::vector<std::string>{"node 417 red.short_test_failed 0->1"});
+
+    events.clear();
+    EXPECT_EQ(stream.update(417, flags), 0);
+    EXPECT_TRUE(events.empty());
+
+    flags.error_flags.setf2(false);
+    flags.warning_flags.setf2(true);
+    flags.system_status_info.setf7(true);
+    flags.error_flags.setf12(true);
+    EXPECT_EQ(stream.update(417, flags), 4);
+    EXPECT_EQ(events, (std::vector<std::string>{
+        "node 417 yellow.bad_time_sync 0->1",
+        "node 417 red.short_test_failed 1->0",
+        "node 417 red.f12 0->1",
+        "node 417 system.short_test_running 0->1"}));
+
+    // system status is not published
+    events.clear();
+    stream.setMask(FlagIndex::green_mask | FlagIndex::yellow_mask | FlagIndex::red_mask);
+    flags.system_status_info.data = 0;
+    EXPECT_EQ(stream.update(417, flags), 0);
+    EXPECT_EQ(stream.flags(417), FlagIndex::pack(flags));
+
+    stream.reset(417);
+    EXPECT_EQ(stream.update(417, flags), 2);
+    EXPECT_EQ(stream.stats().updates, 5);
+    EXPECT_EQ(stream.stats().events, 7);
+}
+
+TEST(settingsCodec, settings) {
+    std::vector<System_Settings_page0> pages(3);
+    std::vector<uint16_t> values(pages.size() * SettingsCodec::fields);
+    for (size_t i = 0; i < values.size(); i++) {
+        values[i] = uint16_t(i * 1000 + 7);
+    }
+    SettingsCodec::encode(values.data(), pages.size(), pages.data());
+    EXPECT_EQ(pages[0].power_maintained_mode.data, 2007);
+    EXPECT_EQ(pages[1].current_maintained_mode.data, (15000 + 7) & 0x3FFF);
+
+    std::vector<uint16_t> decoded(values.size());
+    SettingsCodec::decode(pages.data(), pages.size(), decoded.data());
+    for (size_t i = 0; i < values.size(); i++) {
+        EXPECT_EQ(decoded[i], values[i] & 0x3FFF);
+    }
+
+    System_Settings_page0 a = pages[0];
+    System_Settings_page0 b = pages[0];
+    EXPECT_TRUE(SettingsCodec::equal(a, b));
+    // unused bits are ignored
+    b.voltage_emergency_mode.data |= 0xC000;
+    EXPECT_TRUE(SettingsCodec::equal(a, b));
+    b.current_maintained_mode.data ^= 1;
+    b.test_voltage_upper_limit.data ^= 0x2000;
+    b.reserved[6].data ^= 4;
+    EXPECT_EQ(SettingsCodec::diff(a, b), (1 << 0) | (1 << 7) | (1 << 14));
+}
+
+// only differing pages are written, pages with known content are not read
+TEST(settingsSync, settings) {
+    DeviceEmulator emulator;
+    SettingsCodec::Values v{};
+    v[0] = 100;
+    v[6] = 2000;
+    System_Settings_page0 desired = SettingsCodec::encode(v);
+    v[6] = 2100;
+    System_Settings_page0 other = SettingsCodec::encode(v);
+
+    SimTransport transport(std::ref(emulator));
+    SettingsSync::Config config;
+    config.window = 8;
+    SettingsSync sync(transport, config);
+    sync.setDesired(0, desired);
+    for (NodeAddr node = 1; node <= 40; node++) {
+        DeviceState &s = emulator.add(node);
+        // every 4th node already has desired content
+        std::memcpy(static_cast<void *>(&s.settings[0]), node % 4 == 0 ? &desired : &other, sizeof(desired));
+        sync.addNode(node);
+    }
+    // known content of 10 nodes, node 2 is special
+    for (NodeAddr node = 1; node <= 10; node++) {
+        sync.setActual(node, 0, emulator.device(node)->settings[0]);
+    }
+    sync.setDesired(2, 0, other);
+    EXPECT_EQ(sync.plan().size(), 40 - 3);
+
+    const SettingsSync::Stats &stats = sync.run();
+    EXPECT_EQ(stats.reads, 30);
+    EXPECT_EQ(stats.writes, 40 - 10 - 1);
+    EXPECT_EQ(stats.written, stats.writes);
+    EXPECT_EQ(stats.unchanged, 10 + 1);
+    EXPECT_EQ(stats.failed, 0);
+    for (NodeAddr node = 1; node <= 40; node++) {
+        EXPECT_TRUE(SettingsCodec::equal(emulator.device(node)->settings[0], node == 2 ? other : desired));
+    }
+    EXPECT_TRUE(sync.plan().empty());
+}
+
+// lost requests are repeated
+TEST(settingsSyncRetry, settings) {
+    DeviceEmulator::Config ec;
+    ec.drop_rate = 0.3;
+    DeviceEmulator emulator(ec);
+    SettingsCodec::Values v{};
+    v[3] = 55;
+    System_Settings_page0 desired = SettingsCodec::encode(v);
+
+    SimTransport transport(std::ref(emulator));
+    SettingsSync::Config config;
+    config.timeout = std::chrono::milliseconds(5);
+    config.retries = 10;
+    SettingsSync sync(transport, config);
+    sync.setDesired(1, desired);
+    for (NodeAddr node = 1; node <= 20; node++) {
+        emulator.add(node);
+        sync.addNode(node);
+    }
+    const SettingsSync::Stats &stats = sync.run();
+    EXPECT_GT(stats.timeouts, 0);
+    EXPECT_EQ(stats.failed, 0);
+    EXPECT_EQ(stats.written, 20);
+    for (NodeAddr node = 1; node <= 20; node++) {
+        EXPECT_TRUE(SettingsCodec::equal(emulator.device(node)->settings[1], desired));
+    }
+}
+
+// page desired only for one node is synchronised on that node
+TEST(settingsSyncNodePage, settings) {
+    DeviceEmulator emulator;
+    SettingsCodec::Values v{};
+    v[1] = 10;
+    System_Settings_page0 fleet = SettingsCodec::encode(v);
+    v[1] = 20;
+    System_Settings_page0 node = SettingsCodec::encode(v);
+
+    SimTransport transport(std::ref(emulator));
+    SettingsSync sync(transport);
+    sync.setDesired(0, fleet);
+    sync.setDesired(3, 1, node);
+    for (NodeAddr n = 1; n <= 5; n++) {
+        emulator.add(n);
+        sync.addNode(n);
+    }
+    EXPECT_EQ(sync.plan().size(), 5 + 1);
+
+    const SettingsSync::Stats &stats = sync.run();
+    EXPECT_EQ(stats.written, 5 + 1);
+    EXPECT_EQ(stats.failed, 0);
+    EXPECT_TRUE(SettingsCodec::equal(emulator.device(3)->settings[1], node));
+    EXPECT_FALSE(SettingsCodec::equal(emulator.device(2)->settings[1], node));
+    for (NodeAddr n = 1; n <= 5; n++) {
+        EXPECT_TRUE(SettingsCodec::equal(emulator.device(n)->settings[0], fleet));
+    }
+    EXPECT_TRUE(sync.plan().empty());
+}
+
+// repeated requests refused by the busy transport are sent later without using a retry
+TEST(settingsSyncBusy, settings) {
+    DeviceEmulator emulator;
+    SettingsCodec::Values v{};
+    v[2] = 77;
+    System_Settings_page0 desired = SettingsCodec::encode(v);
+
+    // responses come after the timeout and fill the transport
+    SimTransport::Config tc;
+    tc.latency = std::chrono::milliseconds(4);
+    tc.max_in_flight = 4;
+    SimTransport transport(std::ref(emulator), tc);
+    SettingsSync::Config config;
+    config.window = 16;
+    config.timeout = std::chrono::milliseconds(2);
+    config.retries = 1;
+    SettingsSync sync(transport, config);
+    sync.setDesired(0, desired);
+    for (NodeAddr node = 1; node <= 40; node++) {
+        emulator.add(node);
+        sync.addNode(node);
+    }
+    const SettingsSync::Stats &stats = sync.run();
+    EXPECT_GT(stats.timeouts, 0);
+    EXPECT_EQ(stats.failed, 0);
+    EXPECT_EQ(stats.written, 40);
+    for (NodeAddr node = 1; node <= 40; node++) {
+        EXPECT_TRUE(SettingsCodec::equal(emulator.device(node)->settings[0], desired));
+    }
+}
+
+// day by day reference of the schedule masks
+static bool scheduleMatchesDay(const Test_Schedule &s, int64_t days) {
+    CivilDate d = CivilTime::civilFromDays(days);
+    return ((d.year % 100) & s.year_mask.data) == (s.year.data & s.year_mask.data)
+        && s.months.data >> (d.month - 1) & 1
+        && s.days_of_month.data >> (d.day - 1) & 1
+        && s.days_of_week.data >> CivilTime::weekdayFromDays(days) & 1;
+}
+
+TEST(scheduleEngine, schedule) {
+    Test_Schedule s{};
+    s.start_time.hr = 3;
+    s.start_time.min = 30;
+    // Mondays of January and July
+    s.days_of_week.data = 1 << 1;
+    s.days_of_month.data = 0xFFFFFFFF;
+    s.months.data = 1 << 0 | 1 << 6;
+    const int64_t from = CivilTime::daysFromCivil(2024, 1, 1) * CivilTime::seconds_per_day;
+    std::vector<int64_t> next = ScheduleEngine::next(s, from, 6);
+    ASSERT_EQ(next.size(), 6);
+    // 1 January 2024 is Monday
+    EXPECT_EQ(next[0], from + 3 * 3600 + 30 * 60);
+    EXPECT_EQ(next[4], CivilTime::daysFromCivil(2024, 1, 29) * CivilTime::seconds_per_day + 3 * 3600 + 30 * 60);
+    EXPECT_EQ(next[5], CivilTime::daysFromCivil(2024, 7, 1) * CivilTime::seconds_per_day + 3 * 3600 + 30 * 60);
+    // start time passed
+    int64_t t;
+    ASSERT_TRUE(ScheduleEngine::next(s, from + 4 * 3600, t));
+    EXPECT_EQ(t, next[1]);
+
+    // 29 February only in years ending with 0, 4 or 8 of even tens
+    s.days_of_week.data = 0x7F;
+    s.days_of_month.data = 1u << 28;
+    s.months.data = 1 << 1;
+    s.year = 0;
+    s.year_mask = 0x03;
+    ASSERT_TRUE(ScheduleEngine::next(s, from, t));
+    EXPECT_EQ(CivilTime::civilFromDays(CivilTime::daysFromSeconds(t)).year, 2024);
+    ASSERT_TRUE(ScheduleEngine::next(s, t + 1, t));
+    EXPECT_EQ(CivilTime::civilFromDays(CivilTime::daysFromSeconds(t)).year, 2028);
+
+    // never matching
+    s.days_of_month.data = 1u << 30;
+    EXPECT_FALSE(ScheduleEngine::next(s, from, t));
+    EXPECT_TRUE(ScheduleEngine::next(s, from, 4).empty());
+}
+
+// engine matches day by day iteration for random masks
+TEST(scheduleEngineRandom, schedule) {
+    std::mt19937 random(7);
+    const int64_t base = CivilTime::daysFromCivil(2020, 1, 1);
+    for (int i = 0; i < 300; i++) {
+        Test_Schedule s{};
+        s.start_time.hr = random() % 24;
+        s.start_time.min = random() % 60;
+        s.days_of_week.data = random() & 0x7F;
+        s.days_of_month.data = random() & random();
+        s.months.data = random() & 0xFFF;
+        s.year = random() % 100;
+        s.year_mask = random() & random() & 0x7F;
+        int64_t from = (base + random() % 3000) * CivilTime::seconds_per_day + random() % CivilTime::seconds_per_day;
+        int64_t next[3];
+        size_t n = ScheduleEngine::next(s, from, 3, next);
+
+        int64_t day = CivilTime::daysFromSeconds(from);
+        int64_t start = ScheduleEngine::startSeconds(s);
+        size_t found = 0;
+        for (int64_t d = day; d < day + 366 * 12 && found < 3; d++) {
+            int64_t occurrence = d * CivilTime::seconds_per_day + start;
+            if (occurrence >= from && scheduleMatchesDay(s, d)) {
+                ASSERT_LT(found, n);
+                EXPECT_EQ(next[found], occurrence);
+                found++;
+            }
+        }
+        if (found < 3) {
+            // rare schedules may not repeat within the checked years
+            EXPECT_GE(n, found);
+        } else {
+            EXPECT_EQ(n, 3);
+        }
+    }
+}
+
+TEST(staggerPlanner, schedule) {
+    Test_Schedule base{};
+    base.start_time.hr = 2;
+    base.days_of_week.data = 1 << 3;
+    base.days_of_month.data = 0xFFFFFFFF;
+    base.months.data = 0xFFF;
+    std::vector<NodeAddr> nodes(1000);
+    std::iota(nodes.begin(), nodes.end(), NodeAddr(1));
+
+    const int64_t from = CivilTime::daysFromCivil(2024, 1, 1) * CivilTime::seconds_per_day;
+    const int64_t to = from + 28 * CivilTime::seconds_per_day;
+    std::vector<StaggerPlanner::Assignment> same(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        same[i].node = nodes[i];
+        same[i].schedule = base;
+    }
+    EXPECT_EQ(StaggerPlanner::peak(same, from, to), 1000);
+
+    StaggerPlanner::Config config;
+    config.window_start = 23 * 60;
+    config.window = 200;
+    config.slot = 2;
+    std::vector<StaggerPlanner::Assignment> plan = StaggerPlanner::plan(base, nodes, config);
+    ASSERT_EQ(plan.size(), nodes.size());
+    EXPECT_EQ(StaggerPlanner::peak(plan, from, to), 10);
+    EXPECT_EQ(plan[1].node, 2);
+    EXPECT_EQ(plan[1].schedule.start_time.hr, 23);
+    EXPECT_EQ(plan[1].schedule.start_time.min, 2);
+    // wrapped around midnight
+    EXPECT_EQ(plan[99].schedule.start_time.hr, 2);
+    EXPECT_EQ(plan[99].schedule.start_time.min, 18);
+    EXPECT_EQ(plan[99].schedule.days_of_week.data, base.days_of_week.data);
+}
+
+TEST(set_schedule, commands) {
+    DeviceEmulator emulator;
+    emulator.add(5);
+    Test_Schedule schedule{};
+    schedule.start_time.hr = 4;
+    schedule.start_time.min = 15;
+    schedule.days_of_week.data = 0x3E;
+    schedule.days_of_month.data = 0x7FFFFFFF;
+    schedule.months.data = 0xFFF;
+    schedule.year_mask = 0;
+
+    SetSchedule cmd;
+    cmd.setSelection(3);
+    cmd.setSchedule(schedule);
+    std::vector<uint8_t> request = cmd.serialize();
+    uint8_t response[64];
+    size_t n = emulator.respond(5, request.data(), request.size(), response, sizeof(response));
+    ASSERT_GT(n, 0);
+    cmd.deserialize(response, n);
+    EXPECT_TRUE(cmd.getStatus());
+    EXPECT_EQ(cmd.getData().status, 3);
+    const Test_Schedule &stored = emulator.device(5)->schedules[3];
+    EXPECT_EQ(stored.start_time.hr, 4);
+    EXPECT_EQ(stored.start_time.min, 15);
+    EXPECT_EQ(stored.days_of_week.data, 0x3E);
+    EXPECT_EQ(stored.days_of_month.data, 0x7FFFFFFFu);
+}
+
+TEST(broadcast, broadcast) {
+    DeviceEmulator::Config ec;
+    ec.drop_rate = 0.2;
+    DeviceEmulator emulator(ec);
+    SimTransport transport(std::ref(emulator));
+    Broadcast::Config config;
+    config.timeout = std::chrono::milliseconds(5);
+    config.retries = 20;
+    Broadcast broadcast(transport, config);
+    for (NodeAddr node = 1; node <= 200; node++) {
+        emulator.add(node).flags.error_flags.data = 0x12;
+        broadcast.addNode(node);
+    }
+    // node 300 doesn't exist
+    broadcast.addNode(300);
+    broadcast.setCommand<ResetFlagsCmd>();
+
+    EXPECT_FALSE(broadcast.run());
+    const Broadcast::Stats &stats = broadcast.stats();
+    EXPECT_EQ(stats.encodes, 1);
+    EXPECT_EQ(stats.rounds, 21);
+    EXPECT_EQ(stats.acks, 200);
+    EXPECT_EQ(stats.failed, 1);
+    // first round goes to all nodes, retries only to the missing ones
+    EXPECT_GT(stats.retried, 0);
+    EXPECT_LT(stats.retried, 100 + 21);
+    EXPECT_EQ(broadcast.ackCount(), 200);
+    EXPECT_TRUE(broadcast.acked(200));
+    EXPECT_FALSE(broadcast.acked(300));
+    EXPECT_EQ(broadcast.missing(), std::vector<NodeAddr>{300});
+    for (NodeAddr node = 1; node <= 200; node++) {
+        EXPECT_EQ(emulator.device(node)->flags.error_flags.data, 0);
+    }
+    std::vector<uint8_t> single = ResetFlagsCmd().serialize();
+    EXPECT_EQ(broadcast.frame(), single);
+}
+
+// transport taking fewer frames than nodes doesn't use up retries of the nodes not sent yet
+TEST(broadcastBackpressure, broadcast) {
+    DeviceEmulator emulator;
+    SimTransport::Config tc;
+    tc.latency = std::chrono::microseconds(200);
+    tc.max_in_flight = 32;
+    SimTransport transport(std::ref(emulator), tc);
+    Broadcast::Config config;
+    config.timeout = std::chrono::milliseconds(20);
+    config.retries = 0;
+    Broadcast broadcast(transport, config);
+    for (NodeAddr node = 1; node <= 200; node++) {
+        emulator.add(node);
+        broadcast.addNode(node);
+    }
+    broadcast.setCommand<ResetFlagsCmd>();
+    EXPECT_TRUE(broadcast.run());
+    EXPECT_EQ(broadcast.stats().rounds, 1);
+    EXPECT_EQ(broadcast.stats().sent, 200);
+    EXPECT_EQ(broadcast.stats().retried, 0);
+    EXPECT_EQ(broadcast.stats().failed, 0);
+    EXPECT_EQ(broadcast.ackCount(), 200);
+}
+
+// negative status of the response isn't acknowledgement and isn't repeated
+TEST(broadcastRefused, broadcast) {
+    DeviceEmulator emulator;
+    SimTransport transport(std::ref(emulator));
+    Broadcast broadcast(transport);
+    for (NodeAddr node = 1; node <= 10; node++) {
+        emulator.add(node).preset_valid = node % 2 == 0;
+        broadcast.addNode(node);
+    }
+    broadcast.setCommand<ChangeRtcToPresetCmd>();
+    broadcast.setAcceptor([](NodeAddr, const FrameView &frame) {
+        const ChangeRtcToPresetCmd::data_t *d = ChangeRtcToPresetCmd::impl_type::payload(frame);
+        return d != nullptr && d->result.data == 1;
+    });
+    EXPECT_TRUE(broadcast.run());
+    EXPECT_EQ(broadcast.stats().acks, 5);
+    EXPECT_EQ(broadcast.stats().refused, 5);
+    EXPECT_EQ(broadcast.stats().rounds, 1);
+    EXPECT_TRUE(broadcast.acked(4));
+    EXPECT_TRUE(broadcast.refused(3));
+    EXPECT_TRUE(broadcast.missing().empty());
+}
+
+TEST(fleetTimeSync, time) {
+    DeviceEmulator::Config ec;
+    ec.drop_rate = 0.1;
+    DeviceEmulator emulator(ec);
+    SimTransport transport(std::ref(emulator));
+    FleetTimeSync::Config config;
+    config.tz = TimeZone::fixed(std::chrono::hours(1));
+    config.lead = std::chrono::milliseconds(0);
+    config.sample = 10;
+    config.timeout = std::chrono::milliseconds(5);
+    config.retries = 20;
+    config.resync_rounds = 1;
+    FleetTimeSync sync(transport, config);
+
+    FlagIndex flags;
+    for (NodeAddr node = 1; node <= 100; node++) {
+        DeviceState &s = emulator.add(node);
+        // clock of node 55 is set 30 s wrong, node 77 has bad_time_sync
+        s.rtc_error = node == 55 ? 30 : 0;
+        s.flags.warning_flags.setf2(node == 55 || node == 77);
+        flags.update(node, s.flags);
+        sync.addNode(node);
+    }
+    sync.setFlags(flags);
+
+    EXPECT_FALSE(sync.run());
+    const FleetTimeSync::Stats &stats = sync.stats();
+    EXPECT_EQ(stats.rounds, 2);
+    EXPECT_EQ(stats.failed, 0);
+    // with zero lead a preset phase crossing the second boundary is repeated
+    if (stats.late == 0) {
+        EXPECT_EQ(stats.presets, 101);
+    } else {
+        EXPECT_GT(stats.presets, 101);
+    }
+    // bad time nodes are read back in addition to the sample
+    EXPECT_GE(stats.reads, 10 + 2 + 1);
+    EXPECT_LE(stats.reads, 11 + 2 + 1);
+    EXPECT_EQ(stats.drifting, 2);
+    EXPECT_EQ(sync.resync(), std::vector<NodeAddr>{55});
+
+    FleetTimeSync::Measurement m;
+    ASSERT_TRUE(sync.measurement(55, m));
+    EXPECT_GE(m.offset.count(), 29);
+    EXPECT_LE(m.offset.count(), 30);
+    ASSERT_TRUE(sync.measurement(77, m));
+    EXPECT_LE(std::abs(m.offset.count()), 1);
+    EXPECT_FALSE(sync.measurement(78, m));
+
+    // all nodes have the same clock
+    auto time = DateTimeBase::convertToTimePoint(emulator.device(1)->rtc, config.tz);
+    for (NodeAddr node = 2; node <= 100; node++) {
+        if (node != 55) {
+            EXPECT_EQ(DateTimeBase::convertToTimePoint(emulator.device(node)->rtc, config.tz), time);
+        }
+    }
+    EXPECT_LE(std::abs(std::chrono::duration_cast<std::chrono::seconds>(time - std::chrono::system_clock::now()).count()), 2);
+}
+
+TEST(fleetTimeSync, late) {
+    DeviceEmulator emulator;
+    // preset phase takes longer than the time to the first commit time
+    SimTransport::Config tc;
+    tc.latency = std::chrono::milliseconds(1100);
+    SimTransport transport(std::ref(emulator), tc);
+    FleetTimeSync::Config config;
+    config.tz = TimeZone::fixed(std::chrono::hours(1));
+    config.lead = std::chrono::milliseconds(0);
+    config.timeout = std::chrono::milliseconds(1500);
+    config.resync_rounds = 0;
+    FleetTimeSync sync(transport, config);
+    for (NodeAddr node = 1; node <= 5; node++) {
+        emulator.add(node);
+        sync.addNode(node);
+    }
+
+    EXPECT_TRUE(sync.run());
+    const FleetTimeSync::Stats &stats = sync.stats();
+    EXPECT_EQ(stats.rounds, 1);
+    EXPECT_EQ(stats.late, 1);
+    EXPECT_EQ(stats.presets, 10);
+    EXPECT_EQ(stats.commits, 5);
+    EXPECT_EQ(stats.failed, 0);
+
+    // clocks were switched to the commit time of the second preset, not to a time in the past
+    auto time = DateTimeBase::convertToTimePoint(emulator.device(1)->rtc, config.tz);
+    for (NodeAddr node = 2; node <= 5; node++) {
+        EXPECT_EQ(DateTimeBase::convertToTimePoint(emulator.device(node)->rtc, config.tz), time);
+    }
+    EXPECT_LE(std::abs(std::chrono::duration_cast<std::chrono::seconds>(time - std::chrono::system_clock::now()).count()), 2);
+}
+
+TEST(commandCodec, codec) {
+    // request of the stateless codec is the same as of the command object
+    GetSettingsCmd::data_send_t page{UINT8(2)};
+    GetSettingsCmd get;
+    get.setPage(2);
+    std::vector<uint8_t> expected = get.serialize();
+    uint8_t buf[Codec<GetSettingsCmd>::secure_frame_size];
+    ASSERT_EQ(Codec<GetSettingsCmd>::encode(page, buf, sizeof(buf), true), expected.size());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), buf));
+    EXPECT_EQ(Codec<GetSettingsCmd>::encode(page, buf, sizeof(buf) - 1, true), 0);
+    uint8_t empty[Codec<GetFlagsCmd>::frame_size];
+    ASSERT_EQ(Codec<GetFlagsCmd>::encode(empty, sizeof(empty)), sizeof(empty));
+    EXPECT_EQ(GetFlagsCmd().serialize(), std::vector<uint8_t>(empty, empty + sizeof(empty)));
+
+    GetFlagsCmd::data_t flags{};
+    flags.warning_flags.data = 0x1234;
+    flags.additional_status_info.data = 0x56;
+    uint8_t response[Codec<GetFlagsCmd>::response_size];
+    FrameCodec::encode(response, sizeof(response), CMD_GET_FLAGS, &flags, sizeof(flags));
+
+    GetFlagsCmd::data_t out{};
+    EXPECT_EQ(Codec<GetFlagsCmd>::decode(response, sizeof(response), out), FRAME_OK);
+    EXPECT_EQ(out.warning_flags.data, 0x1234);
+    EXPECT_EQ(Codec<GetFlagsCmd>::decode(response, sizeof(response)).additional_status_info.data, 0x56);
+
+    // invalid frame doesn't change the output
+    response[3] ^= 1;
+    GetFlagsCmd::data_t unchanged{};
+    EXPECT_EQ(Codec<GetFlagsCmd>::decode(response, sizeof(response), unchanged), FRAME_BAD_CRC);
+    EXPECT_EQ(unchanged.warning_flags.data, 0);
+    EXPECT_THROW(Codec<GetFlagsCmd>::decode(response, sizeof(response)), std::logic_error);
+    // other command
+    response[3] ^= 1;
+    GetVersionCmd::data_t version;
+    EXPECT_EQ(Codec<GetVersionCmd>::decode(response, sizeof(response), version), FRAME_BAD_ID);
+}
+
+// shared frames are decoded by many threads without command objects
+TEST(commandCodecThreads, codec) {
+    const size_t frames = 1000;
+    std::vector<uint8_t> data(frames * Codec<GetFlagsCmd>::response_size);
+    for (size_t i = 0; i < frames; i++) {
+        GetFlagsCmd::data_t flags{};
+        flags.error_flags.data = uint16_t(i);
+        FrameCodec::encode(&data[i * Codec<GetFlagsCmd>::response_size], Codec<GetFlagsCmd>::response_size, CMD_GET_FLAGS, &flags, sizeof(flags));
+    }
+    std::vector<std::thread> workers;
+    std::atomic<size_t> errors(0);
+    for (int t = 0; t < 4; t++) {
+        workers.emplace_back([&data, &errors, frames]() {
+            for (int pass = 0; pass < 20; pass++) {
+                for (size_t i = 0; i < frames; i++) {
+                    GetFlagsCmd::data_t flags;
+                    if (Codec<GetFlagsCmd>::decode(&data[i * Codec<GetFlagsCmd>::response_size], Codec<GetFlagsCmd>::response_size, flags) != FRAME_OK
+                        || flags.error_flags.data != i) {
+                        errors++;
+                    }
+                }
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    EXPECT_EQ(errors.load(), 0);
+}
+
+// reused command returns only the last frame and doesn't grow its buffers
+TEST(commandReuse, commands) {
+    GetSettingsCmd cmd;
+    cmd.setPage(1);
+    std::vector<uint8_t> first = cmd.serialize();
+    cmd.setPage(2);
+    std::vector<uint8_t> second = cmd.serialize();
+    EXPECT_EQ(first.size(), second.size());
+    EXPECT_NE(first, second);
+
+    GetSettingsCmd::data_t page{};
+    page.system_settings_page = 2;
+    std::vector<uint8_t> response(Codec<GetSettingsCmd>::response_size);
+    FrameCodec::encode(response.data(), response.size(), CMD_GET_SETTINGS, &page, sizeof(page));
+    cmd.deserialize(response);
+    const size_t capacity = cmd.capacity();
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ(cmd.serialize(), second);
+        cmd.deserialize(response);
+    }
+    EXPECT_EQ(cmd.capacity(), capacity);
+    EXPECT_EQ(cmd.getData().system_settings_page, 2);
+
+    cmd.reset();
+    EXPECT_EQ(cmd.getData().system_settings_page, 0);
+    EXPECT_EQ(cmd.capacity(), capacity);
+    // parameters are kept
+    EXPECT_EQ(cmd.serialize(), second);
+
+    GetSettingsCmd::impl_type impl;
+    impl.serialize();
+    impl.release();
+    EXPECT_EQ(impl.capacity(), 0);
+}
@@ -3,17 +3,29 @@
 #include <string>
 #include <vector>
 #include <cstring>
+#include <cstdint>
 #include <iostream> 
 #include <sstream>
 #include <algorithm>
 #include <exception>
 #include <chrono>
+#include <array>
+#include <utility>
+#include <atomic>
+#include <ctime>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LGMC_SSE2
+#endif
 
 namespace lgmc {
 
 /* definitions for packed structures for GCC and MSC */
 #ifdef __GNUC__
-#define PACK( __Declaration__ ) __Declaration__ __attribute__((__packed__))
+// __attribute__((__packed__)) is ignored for non-POD members (UINT8, UINT16, ...) so pragma is used,
+// pop must follow the terminating semicolon of the declaration
+#define PACK( __Declaration__ ) _Pragma("pack(push, 1)") __Declaration__; _Pragma("pack(pop)")
 #endif
 
 #ifdef _MSC_VER
@@ -22,9 +34,9 @@ namespace lgmc {
 
 // define generic get/set methods for specific bit
 #define F(nr) \
-  bool f##nr() { \
-    return data & (nr + 1); \
-    } \
+  bool f##nr() const { \
+    return (data >> nr) & 1; \
+  } \
   void setf##nr(bool val) { \
     if (val) { \
       data |= (1 << nr); \
@@ -372,6 +384,80 @@ namespace lgmc {
     UINT14 reserved[7];
   });
 
+  /* bulk codec of settings pages, every field is 14 bit value stored in 2 bytes
+   * pages are compared in 64 bit words with the unused bits masked out
+   */
+  class SettingsCodec {
+    public:
+      enum : size_t {
+        fields = 15,
+        page_size = fields * 2,
+      };
+
+      enum : uint16_t {
+        value_mask = 0x3FFF,
+      };
+
+      typedef std::array<uint16_t, fields> Values;
+
+      static Values decode(const System_Settings_page0 &page) {
+        Values v;
+        decode(&page, 1, v.data());
+        return v;
+      }
+
+      // fields of n pages to out, fields * n values
+      static void decode(const System_Settings_page0 *pages, size_t n, uint16_t *out) {
+        static_assert(sizeof(System_Settings_page0) == page_size, "settings page is expected to be packed");
+        std::memcpy(out, pages, n * page_size);
+        for (size_t i = 0; i < n * fields; i++) {
+          out[i] &= value_mask;
+        }
+      }
+
+      static System_Settings_page0 encode(const Values &values) {
+        System_Settings_page0 page;
+        encode(values.data(), 1, &page);
+        return page;
+      }
+
+      // fields * n values to n pages, values are truncated to 14 bits
+      static void encode(const uint16_t *values, size_t n, System_Settings_page0 *pages) {
+        uint8_t *out = reinterpret_cast<uint8_t *>(pages);
+        for (size_t i = 0; i < n * fields; i++) {
+          uint16_t v = values[i] & value_mask;
+          std::memcpy(out + i * 2, &v, 2);
+        }
+      }
+
+      static bool equal(const System_Settings_page0 &a, const System_Settings_page0 &b) {
+        return diff(a, b) == 0;
+      }
+
+      // bit per differing field, reserved fields are compared too
+      static uint16_t diff(const System_Settings_page0 &a, const System_Settings_page0 &b) {
+        // 30 bytes as 4 words, last one overlaps
+        static const size_t offsets[4] = {0, 8, 16, page_size - 8};
+        const uint64_t mask = 0x3FFF3FFF3FFF3FFFull;
+        const uint8_t *pa = reinterpret_cast<const uint8_t *>(&a);
+        const uint8_t *pb = reinterpret_cast<const uint8_t *>(&b);
+        uint16_t result = 0;
+        for (size_t w = 0; w < 4; w++) {
+          uint64_t wa;
+          uint64_t wb;
+          std::memcpy(&wa, pa + offsets[w], 8);
+          std::memcpy(&wb, pb + offsets[w], 8);
+          uint64_t x = (wa ^ wb) & mask;
+          for (size_t f = 0; x != 0 && f < 4; f++, x >>= 16) {
+            if (x & value_mask) {
+              result |= uint16_t(1 << (offsets[w] / 2 + f));
+            }
+          }
+        }
+        return result;
+      }
+  };
+
   // Report generated following a duration test
   PACK(struct Long_Test_Report {
     System_Compressed_Date start_date;
@@ -396,8 +482,8 @@ namespace lgmc {
   });
 
   // Report generated following a basic function test
-  struct Short_Test_Report {
-     System_Compressed_Date start_date;
+  PACK(struct Short_Test_Report {
+    System_Compressed_Date start_date;
     System_Compressed_Time start_time;
     BATTSTATUS8 start_cell_mode;
     UINT16 bottom_cell_volts;
@@ -405,7 +491,7 @@ namespace lgmc {
     UINT16 load_volts;
     UINT16 load_current;
     FLAGS8 test_flags;
-  };
+  });
 
   // specifies when a test will begin
   struct Test_Schedule {
@@ -472,6 +558,342 @@ namespace lgmc {
     printf("]\n");
   }
 
+  // result of the frame validation
+  enum FrameStatus {
+    FRAME_OK = 0,
+    FRAME_BAD_START_STOP,
+    FRAME_BAD_CRC,
+    // frame is too short or length byte doesn't match the frame size
+    FRAME_BAD_LENGTH,
+    FRAME_BAD_ID,
+    FRAME_STATUS_COUNT,
+  };
+
+  inline const char * frameStatusName(FrameStatus status) {
+    switch (status) {
+      case FRAME_OK: return "ok";
+      case FRAME_BAD_START_STOP: return "bad start/stop byte";
+      case FRAME_BAD_CRC: return "bad crc";
+      case FRAME_BAD_LENGTH: return "bad length";
+      case FRAME_BAD_ID: return "bad id";
+      default: return "unknown";
+    }
+  }
+
+  // counters of validation results
+  struct FrameStats {
+    uint64_t counts[FRAME_STATUS_COUNT] = {};
+
+    FrameStatus add(FrameStatus status) {
+      counts[status]++;
+      return status;
+    }
+
+    uint64_t count(FrameStatus status) const {
+      return counts[status];
+    }
+
+    uint64_t errors() const {
+      uint64_t n = 0;
+      for (int i = FRAME_OK + 1; i < FRAME_STATUS_COUNT; i++) {
+        n += counts[i];
+      }
+      return n;
+    }
+
+    uint64_t total() const {
+      return counts[FRAME_OK] + errors();
+    }
+
+    void reset() {
+      *this = FrameStats();
+    }
+  };
+
+  /* frame encoder writing directly to the caller's buffer
+   * frame layout: [start][len][id][security bytes][payload][crc][stop]
+   * len counts id, security bytes and payload, crc is sum of bytes from len to end of payload
+   */
+  class FrameCodec {
+    public:
+      enum : uint8_t {
+        start_byte = 0xB1,
+        stop_byte = 0xB2,
+      };
+
+      enum : size_t {
+        // start, len, id, crc and stop bytes
+        overhead_size = 5,
+        // security bytes have always 4 bytes
+        security_size = 4,
+      };
+
+      // size of the whole frame for the payload of given size
+      static constexpr size_t frameSize(size_t payload_size, bool security_bytes = false) {
+        return overhead_size + payload_size + (security_bytes ? size_t(security_size) : 0);
+      }
+
+      // crc and third security byte of the frame
+      struct Checksums {
+        uint8_t crc;
+        uint8_t security;
+      };
+
+      /* sum of bytes, 16 bytes at once by SSE2 horizontal sums when available */
+      static uint32_t byteSum(const uint8_t *data, size_t size) {
+        uint32_t sum = 0;
+        size_t i = 0;
+#ifdef LGMC_SSE2
+        if (size >= 16) {
+          const __m128i zero = _mm_setzero_si128();
+          __m128i acc = zero;
+          for (; i + 16 <= size; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            // two 64-bit sums of 8 bytes each
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+          }
+          sum = uint32_t(_mm_cvtsi128_si32(acc)) + uint32_t(_mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc)));
+        }
+#endif
+        for (; i < size; i++) {
+          sum += data[i];
+        }
+        return sum;
+      }
+
+      /* crc and security byte from a single pass over the payload
+       * both are linear in the payload sum, so the sum is computed once
+       */
+      static Checksums checksums(uint8_t len, uint8_t id, const uint8_t *payload, size_t payload_size, bool security_bytes) {
+        uint32_t sum = byteSum(payload, payload_size);
+        Checksums c;
+        c.security = securityByte(len, id, sum, payload_size);
+        c.crc = uint8_t(len + id + sum + (security_bytes ? 9 + 227 + c.security + id : 0));
+        return c;
+      }
+
+      /* verify batch of received frames, status of each frame is stored to results
+       * returns number of valid frames
+       */
+      static size_t verify(const uint8_t * const *frames, const size_t *sizes, size_t count, FrameStatus *results);
+
+      /* encode frame in one pass, returns number of written bytes or 0 if buffer is too small */
+      static size_t encode(uint8_t *buf, size_t size, uint8_t id, const void *payload, size_t payload_size, bool security_bytes = false) {
+        size_t frame_size = frameSize(payload_size, security_bytes);
+        // len byte counts everything except start, len, crc and stop
+        if (buf == nullptr || size < frame_size || frame_size - 4 > 0xFF) {
+          return 0;
+        }
+        const uint8_t *p = static_cast<const uint8_t *>(payload);
+        uint8_t len = uint8_t(frame_size - 4);
+        size_t pos = 0;
+
+        buf[pos++] = start_byte;
+        buf[pos++] = len;
+        buf[pos++] = id;
+
+        uint8_t *security = buf + pos;
+        if (security_bytes) {
+          pos += security_size;
+        }
+
+        if (payload_size > 0) {
+          std::memcpy(buf + pos, p, payload_size);
+        }
+        Checksums sums = checksums(len, id, buf + pos, payload_size, security_bytes);
+        pos += payload_size;
+
+        if (security_bytes) {
+          security[0] = 9;
+          security[1] = 227;
+          security[2] = sums.security;
+          security[3] = id;
+        }
+
+        buf[pos++] = sums.crc;
+        buf[pos++] = stop_byte;
+        return pos;
+      }
+
+      template <size_t N>
+      static size_t encode(std::array<uint8_t, N> &buf, uint8_t id, const void *payload, size_t payload_size, bool security_bytes = false) {
+        return encode(buf.data(), N, id, payload, payload_size, security_bytes);
+      }
+
+      /* third security byte is sum of ~(x + 1) over len, id and payload bytes,
+       * ~(x + 1) is 254 - x in 8 bits so it can be computed from the plain sum of payload */
+      static constexpr uint8_t securityByte(uint8_t len, uint8_t id, uint32_t payload_sum, size_t payload_size) {
+        return uint8_t(254 * (payload_size + 2) - len - id - payload_sum);
+      }
+
+      /* byte at given position of the frame without payload, usable in constant expressions */
+      static constexpr uint8_t emptyFrameByte(size_t pos, uint8_t id, bool security_bytes) {
+        const uint8_t len = security_bytes ? 1 + security_size : 1;
+        const uint8_t security = securityByte(len, id, 0, 0);
+        const uint8_t crc = uint8_t(len + id + (security_bytes ? 9 + 227 + security + id : 0));
+        const size_t size = frameSize(0, security_bytes);
+
+        if (pos == 0) return start_byte;
+        if (pos == 1) return len;
+        if (pos == 2) return id;
+        if (pos == size - 2) return crc;
+        if (pos == size - 1) return stop_byte;
+        // security bytes
+        const uint8_t sec[security_size] = {9, 227, security, id};
+        return sec[pos - 3];
+      }
+
+      template <size_t... I>
+      static constexpr std::array<uint8_t, sizeof...(I)> emptyFrame(uint8_t id, bool security_bytes, std::index_sequence<I...>) {
+        return std::array<uint8_t, sizeof...(I)>{{ emptyFrameByte(I, id, security_bytes)... }};
+      }
+  };
+
+  /* read-only view of the received frame
+   * frame is validated in place, payload is accessed without copying
+   */
+  class FrameView {
+    public:
+      FrameView()
+      : m_data(nullptr), m_size(0), m_status(FRAME_BAD_LENGTH) {}
+
+      FrameView(const uint8_t *data, size_t size)
+      : m_data(data), m_size(size), m_status(FRAME_BAD_LENGTH) {
+        m_status = validate();
+      }
+
+      // result of validation of start/stop bytes, length and crc
+      FrameStatus status() const {
+        return m_status;
+      }
+
+      // result of validation including command id
+      FrameStatus status(uint8_t cmd_id) const {
+        if (m_status == FRAME_OK && id() != cmd_id) {
+          return FRAME_BAD_ID;
+        }
+        return m_status;
+      }
+
+      // start/stop bytes, length and crc are correct
+      bool isValid() const {
+        return m_status == FRAME_OK;
+      }
+
+      // frame is valid and carries given command id
+      bool isValid(uint8_t cmd_id) const {
+        return status(cmd_id) == FRAME_OK;
+      }
+
+      // frame is long enough and starts/ends with start/stop bytes
+      bool hasFrameBytes() const {
+        return m_data != nullptr && m_size >= FrameCodec::overhead_size
+          && m_data[0] == FrameCodec::start_byte && m_data[m_size - 1] == FrameCodec::stop_byte;
+      }
+
+      // length byte corresponds to the frame size
+      bool hasValidLength() const {
+        return m_size >= FrameCodec::overhead_size && length() == m_size - 4;
+      }
+
+      // crc of the received bytes
+      uint8_t computeCrc() const {
+        return uint8_t(FrameCodec::byteSum(m_data + 1, m_size - 3));
+      }
+
+      uint8_t length() const { return m_data[1]; }
+      uint8_t id() const { return m_data[2]; }
+      uint8_t crc() const { return m_data[m_size - 2]; }
+
+      const uint8_t * payload() const { return m_data + 3; }
+      size_t payloadSize() const { return m_size - FrameCodec::overhead_size; }
+
+      const uint8_t * data() const { return m_data; }
+      size_t size() const { return m_size; }
+
+      // typed payload pointing to the frame, nullptr if size or alignment doesn't match
+      template <typename T>
+      const T * payloadAs() const {
+        if (!isValid() || payloadSize() != sizeof(T) || reinterpret_cast<uintptr_t>(payload()) % alignof(T) != 0) {
+          return nullptr;
+        }
+        return reinterpret_cast<const T *>(payload());
+      }
+
+    private:
+      FrameStatus validate() const {
+        if (m_data == nullptr || m_size < FrameCodec::overhead_size) {
+          return FRAME_BAD_LENGTH;
+        }
+        if (!hasFrameBytes()) {
+          return FRAME_BAD_START_STOP;
+        }
+        if (computeCrc() != crc()) {
+          return FRAME_BAD_CRC;
+        }
+        if (!hasValidLength()) {
+          return FRAME_BAD_LENGTH;
+        }
+        return FRAME_OK;
+      }
+
+    private:
+      const uint8_t *m_data;
+      size_t m_size;
+      FrameStatus m_status;
+  };
+
+  inline size_t FrameCodec::verify(const uint8_t * const *frames, const size_t *sizes, size_t count, FrameStatus *results) {
+    size_t valid = 0;
+    for (size_t i = 0; i < count; i++) {
+      results[i] = FrameView(frames[i], sizes[i]).status();
+      valid += results[i] == FRAME_OK;
+    }
+    return valid;
+  }
+
+  /* human readable description of the validation error, built only on demand */
+  inline std::string frameStatusMessage(FrameStatus status, const FrameView &v, uint8_t expected_id) {
+    std::ostringstream os;
+    switch (status) {
+      case FRAME_OK:
+        os << "Ok";
+        break;
+      case FRAME_BAD_START_STOP:
+        os << "Wrong start or stop byte: " << std::hex << unsigned(v.data()[0]);
+        break;
+      case FRAME_BAD_CRC:
+        os << "Wrong crc. Computed:" << std::hex << unsigned(v.computeCrc()) << " received:" << unsigned(v.crc());
+        break;
+      case FRAME_BAD_LENGTH:
+        if (v.size() < FrameCodec::overhead_size) {
+          os << "Frame too short: " << v.size();
+        } else {
+          os << "Inconsistency in elements count. Expected:" << unsigned(v.length()) << " but get:" << unsigned(v.size() - 4);
+        }
+        break;
+      case FRAME_BAD_ID:
+        os << "Invalid ID. Expected:" << std::hex << unsigned(expected_id) << " received:" << unsigned(v.id());
+        break;
+      default:
+        os << frameStatusName(status);
+        break;
+    }
+    return os.str();
+  }
+
+  /* copy payload of the valid frame with the command id to out, out is not changed for invalid frame
+   * shorter payload fills the beginning of out
+   */
+  template <typename R>
+  inline FrameStatus decodePayload(const FrameView &v, uint8_t id, R &out) {
+    FrameStatus status = v.status(id);
+    if (status == FRAME_OK) {
+      std::memcpy(static_cast<void *>(&out), v.payload(), std::min(v.payloadSize(), sizeof(R)));
+    }
+    return status;
+  }
+
 template <typename S, typename R>
   class BaseCommand {
     public:
@@ -485,104 +907,59 @@ template <typename S, typename R>
       virtual ~BaseCommand() {
       }
       
-      /* serialize data without parameters */
+      /* serialize data without parameters
+       * frame replaces the previous one, buffer capacity is reused so repeated calls don't grow memory */
       std::vector<uint8_t> serialize(bool security_bytes = false) {
-        m_data.push_back(start_byte);
-        if (security_bytes != false) {
-          // security bytes have always 4 bytes
-          m_data.push_back(1 + 4);
-          m_data.push_back(m_id);
-          std::vector<uint8_t> security = computeSecurityBytes(m_id, 1 + 4);
-          m_data.insert(m_data.end(), security.begin(), security.end());
-        } else {
-          m_data.push_back(1);
-          m_data.push_back(m_id);
-        }
-
-        std::vector<uint8_t> c{m_data.begin() + 1, m_data.end()};
-
-        m_data.push_back(crc(c));
-        m_data.push_back(stop_byte);
-
+        encodeFrame(nullptr, 0, security_bytes);
         return m_data;
       }
 
       /* serialize data with parameters */
       //template <typename T>
       std::vector<uint8_t> serialize(S d, bool security_bytes = false) {
-        BaseData<S> s(d);
-        m_data.push_back(start_byte);
-        if (security_bytes) {
-          m_data.push_back(sizeof(d) + 1 + 4);
-        } else {
-          m_data.push_back(sizeof(d) + 1);
-        }
-        m_data.push_back(m_id);
-        
-        std::vector<uint8_t> ser = s.serialize();
-        if (security_bytes) {
-          std::vector<uint8_t> security = computeSecurityBytes(m_id, 1 + 4 + ser.size(), ser);
-          m_data.insert(m_data.end(), security.begin(), security.end());
-        }
-        m_data.insert(m_data.end(), ser.begin(), ser.end());
-        
-        std::vector<uint8_t> c{m_data.begin() + 1, m_data.end()};
+        encodeFrame(&d, sizeof(d), security_bytes);
+        return m_data;
+      }
 
-        m_data.push_back(crc(c));
-        m_data.push_back(stop_byte);
+      /* serialize data without parameters to the caller's buffer, no allocation
+       * returns size of the frame or 0 if buffer is too small */
+      size_t serialize(uint8_t *buf, size_t size, bool security_bytes = false) const {
+        return FrameCodec::encode(buf, size, m_id, nullptr, 0, security_bytes);
+      }
 
-        return m_data;
+      /* serialize data with parameters to the caller's buffer, no allocation */
+      size_t serialize(const S &d, uint8_t *buf, size_t size, bool security_bytes = false) const {
+        return FrameCodec::encode(buf, size, m_id, &d, sizeof(d), security_bytes);
       }
 
       //template <typename T>
-      bool deserialize(std::vector<uint8_t> d) {
-        BaseData<R> s;
-        // make copy of data to member variable
-        m_recv_data.insert(m_recv_data.end(), d.begin(), d.end());
+      bool deserialize(const std::vector<uint8_t> &d) {
+        // make copy of the last frame to member variable
+        m_recv_data.assign(d.begin(), d.end());
+        return deserialize(d.data(), d.size());
+      }
 
-        // first and last bytes must be start/stop bytes
-        if (d[0] != start_byte || d[d.size()-1] != stop_byte)  {
-          std::ostringstream os;
-          os << "Wrong start or stop byte: " << std::hex << unsigned(d[0]);
-          std::logic_error ex(os.str().c_str());
-          throw ex;
-        }
+      /* deserialize frame in place, raw data are not copied to member variable */
+      bool deserialize(const uint8_t *d, size_t size) {
+        return deserialize(FrameView(d, size));
+      }
 
-        // compute crc and verify crc
-        std::vector<uint8_t> c{d.cbegin() + 1, d.cend() - 2};
-        uint8_t crc_data = crc(c);
-        
-        if (crc_data != d[d.size()-2]) {
-          std::ostringstream os;
-          os << "Wrong crc. Computed:" << std::hex << unsigned(crc_data) << " received:" << unsigned(d[d.size()-2]);
-          std::logic_error ex(os.str().c_str());
+      bool deserialize(const FrameView &v) {
+        FrameStatus status = tryDeserialize(v);
+        if (status != FRAME_OK) {
+          std::logic_error ex(frameStatusMessage(status, v, m_id).c_str());
           throw ex;
         }
+        return true;
+      }
 
-        // check number of received elements
-        uint8_t nr_of_elements = c[0];
-   
-        if ((c.size() - 1) != nr_of_elements) {
-          std::ostringstream os;
-          os << "Inconsistency in elements count. Expected:" << unsigned(nr_of_elements) << " but get:" << unsigned(c.size() -1 );
-          std::logic_error ex(os.str().c_str());
-          throw ex;
-        }
-        // c[1] is command ID
-        if (c[1] != m_id) {
-          std::ostringstream os;
-          os << "Invalid ID. Expected:" << std::hex << unsigned(m_id) << " received:" << unsigned(c[1]);
-          std::logic_error ex(os.str().c_str());
-          throw ex;
-          
-          return false;
-        }
-        
-        // get data only
-        c.erase (c.begin(),c.begin()+2);
+      /* exception-free deserialization, received type is updated only for valid frame */
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return tryDeserialize(FrameView(d, size));
+      }
 
-        m_recv_type = s.deserialize(c);
-        return true;
+      FrameStatus tryDeserialize(const FrameView &v) {
+        return decodePayload(v, m_id, m_recv_type);
       }
 
       void setCommandId(uint8_t id) {
@@ -600,33 +977,32 @@ template <typename S, typename R>
       R getType() const {
         return m_recv_type;
       }
-    private:
-      /* simple crc helper */
-      uint8_t crc(const std::vector<uint8_t> &data) {
-        uint32_t val = 0;
-        for(auto x : data) {
-          val += x;
-        }
-        return val % 256;
-      }
-
-      std::vector<uint8_t> computeSecurityBytes(uint8_t id, int len, std::vector<uint8_t> d = std::vector<uint8_t>()) {
-        std::vector<uint8_t> ret{9, 227, 0, id};
-        uint32_t val = 0;
-        uint8_t lenb = 0xFF & len;
 
-        //lenb += 1;
-        val += 0xFF & (~(lenb+1));
-
-        val += 0xFF & (~(id + 1));
+      /* forget the last request and response, command object can be reused for next poll
+       * buffer capacity is kept, memory use stays constant */
+      void reset() {
+        m_data.clear();
+        m_recv_data.clear();
+        std::memset(static_cast<void *>(&m_recv_type), 0, sizeof(m_recv_type));
+      }
 
-        for (auto x : d) {
-          val += 0xFF & (~(x + 1));
-        }
+      // reset and return buffer memory
+      void release() {
+        reset();
+        std::vector<uint8_t>().swap(m_data);
+        std::vector<uint8_t>().swap(m_recv_data);
+      }
 
-        ret[2] = val % 256;
+      // heap memory held by the command
+      size_t capacity() const {
+        return m_data.capacity() + m_recv_data.capacity();
+      }
 
-        return ret;
+    private:
+      // replace m_data by the encoded frame
+      void encodeFrame(const void *payload, size_t payload_size, bool security_bytes) {
+        m_data.resize(FrameCodec::frameSize(payload_size, security_bytes));
+        FrameCodec::encode(m_data.data(), m_data.size(), m_id, payload, payload_size, security_bytes);
       }
 
     private:
@@ -634,11 +1010,7 @@ template <typename S, typename R>
       std::vector<uint8_t> m_recv_data;
       uint8_t m_id;
       // deserialized type
-      R m_recv_type;
-      
-      // constants
-      const uint8_t start_byte = 0xB1;
-      const uint8_t stop_byte = 0xB2;
+      R m_recv_type{};
   };
 
   /**********************************************/
@@ -648,6 +1020,17 @@ template <typename S, typename R>
   // none struct used in argument when there is no send/receive payload
   struct none { struct value_type {}; };
 
+  // size of the payload on the wire, none has no payload
+  template <typename T>
+  struct PayloadSize {
+    enum : size_t { value = sizeof(T) };
+  };
+
+  template <>
+  struct PayloadSize<none> {
+    enum : size_t { value = 0 };
+  };
+
   enum CommandNumber {
     CMD_GET_SYSTEM_STATUS_1 = 6,
     CMD_GET_VERSION = 9,
@@ -666,12 +1049,110 @@ template <typename S, typename R>
     CMD_RESET_FLAGS = 28,
   };
 
+  // address of the RepM3 device (node) in the network
+  typedef uint16_t NodeAddr;
+
+  /* stateless codec of the command with compile-time frame layout
+   * T is request payload, S is response payload
+   * all functions are static and reentrant, one definition serves any number of threads
+   */
+  template <typename T, typename S, uint8_t id>
+  class CommandCodec {
+    public:
+      typedef T send_type;
+      typedef S recv_type;
+
+      enum : size_t {
+        command_id = id,
+        send_payload_size = PayloadSize<T>::value,
+        recv_payload_size = PayloadSize<S>::value,
+        // size of request frame without and with security bytes
+        frame_size = FrameCodec::overhead_size + send_payload_size,
+        secure_frame_size = frame_size + FrameCodec::security_size,
+        // size of response frame
+        response_size = FrameCodec::overhead_size + recv_payload_size,
+      };
+
+      typedef std::array<uint8_t, frame_size> frame_type;
+      typedef std::array<uint8_t, secure_frame_size> secure_frame_type;
+
+      // encode request to the fixed size frame
+      static frame_type encode(const T &d) {
+        frame_type f;
+        FrameCodec::encode(f, id, &d, send_payload_size);
+        return f;
+      }
+
+      static secure_frame_type encodeSecure(const T &d) {
+        secure_frame_type f;
+        FrameCodec::encode(f, id, &d, send_payload_size, true);
+        return f;
+      }
+
+      // encode request to the caller's buffer, returns frame size or 0 if buffer is too small
+      static size_t encode(const T &d, uint8_t *buf, size_t size, bool security_bytes = false) {
+        return FrameCodec::encode(buf, size, id, &d, send_payload_size, security_bytes);
+      }
+
+      static size_t encode(uint8_t *buf, size_t size, bool security_bytes = false) {
+        static_assert(send_payload_size == 0, "request has payload");
+        return FrameCodec::encode(buf, size, id, nullptr, 0, security_bytes);
+      }
+
+      // request without payload is constant computed at compile time
+      static constexpr frame_type requestFrame() {
+        static_assert(send_payload_size == 0, "request has payload, use encode()");
+        return FrameCodec::emptyFrame(id, false, std::make_index_sequence<frame_size>());
+      }
+
+      static constexpr secure_frame_type secureRequestFrame() {
+        static_assert(send_payload_size == 0, "request has payload, use encodeSecure()");
+        return FrameCodec::emptyFrame(id, true, std::make_index_sequence<secure_frame_size>());
+      }
+
+      // copy response payload to out, out is not changed for invalid frame
+      static FrameStatus decode(const FrameView &v, S &out) {
+        return decodePayload(v, id, out);
+      }
+
+      static FrameStatus decode(const uint8_t *d, size_t size, S &out) {
+        return decodePayload(FrameView(d, size), id, out);
+      }
+
+      // response payload, throws std::logic_error for invalid frame like deserialize()
+      static S decode(const uint8_t *d, size_t size) {
+        FrameView v(d, size);
+        S out{};
+        FrameStatus status = decodePayload(v, id, out);
+        if (status != FRAME_OK) {
+          throw std::logic_error(frameStatusMessage(status, v, id).c_str());
+        }
+        return out;
+      }
+
+      // typed payload of the valid frame with this command id without copying, nullptr otherwise
+      static const S * payload(const FrameView &v) {
+        return v.isValid(id) ? v.payloadAs<S>() : nullptr;
+      }
+  };
+
+  /* command implementation keeping the last request and response
+   * frame layout and static functions are from CommandCodec
+   */
   template <typename T, typename S, uint8_t id>
-  class Impl : public BaseCommand<T, S> {
+  class Impl : public BaseCommand<T, S>, public CommandCodec<T, S, id> {
     public:
+      typedef CommandCodec<T, S, id> codec_type;
+      typedef T send_type;
+      typedef S recv_type;
+
       Impl()
       : BaseCommand<T,S>(id) {}
   };
+
+  // stateless codec of the command class, e.g. Codec<GetFlagsCmd>::decode(data, size, flags)
+  template <typename Cmd>
+  using Codec = typename Cmd::impl_type::codec_type;
   
   class GetVersionCmd {
     public:
@@ -691,16 +1172,42 @@ template <typename S, typename R>
         return impl.serialize();
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t getData() {
         return impl.getType();
       }
 
+  public:
+      typedef Impl<none, GetVersionCmd::data_t, CMD_GET_VERSION> impl_type;
+
   private:
-      Impl<none, GetVersionCmd::data_t, CMD_GET_VERSION> impl;
+      impl_type impl;
   };
 
   /**********************************************/
@@ -709,7 +1216,10 @@ template <typename S, typename R>
 
   class SetSettingsCmd {
     public:
-     
+      SetSettingsCmd() {
+        std::memset(static_cast<void *>(&m_data), 0, sizeof(m_data));
+      }
+
       PACK(struct data_send_t {
         UINT8 system_settings_page;
         System_Compressed_Date date;
@@ -719,18 +1229,41 @@ template <typename S, typename R>
         UINT8 status;
       } data;
 
-      void serialize(std::vector<uint8_t> &d) {
-        d = impl.serialize(); 
+      void serialize(std::vector<uint8_t> &d, bool security = false) {
+        d = impl.serialize(m_data, security);
       }
 
-      std::vector<uint8_t> serialize() {
-        return impl.serialize();
+      std::vector<uint8_t> serialize(bool security = false) {
+        return impl.serialize(m_data, security);
+      }
+
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size, bool security = false) const {
+        return impl.serialize(m_data, buf, size, security);
       }
 
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t getData() {
         return impl.getType();
       }
@@ -739,22 +1272,114 @@ template <typename S, typename R>
         return (getData().status.data == 170); 
       }
 
+      void set_system_settings_page(uint32_t page = 0) {
+        m_data.system_settings_page = UINT8(page);
+      }
+
+      void set_date(uint32_t day_of_month = 0, uint32_t month = 0, uint32_t year = 0) {
+        m_data.date = System_Compressed_Date();
+        m_data.date.set_day_of_month(day_of_month);
+        m_data.date.set_month(month);
+        m_data.date.set_year(year);
+      }
+
+  public:
+      typedef Impl<SetSettingsCmd::data_send_t, SetSettingsCmd::data_t, CMD_SET_SETTINGS> impl_type;
+
   private:
-      Impl<SetSettingsCmd::data_send_t, SetSettingsCmd::data_t, CMD_SET_SETTINGS> impl;
-
-    /*void set_system_settings_page(uint32_t page = 0) { data_sent.data().system_settings_page = page;} 
-    void set_date(uint32_t day_of_month = 0, uint32_t month = 0, uint32_t year = 0) { 
-      data_sent.data().date.set_day_of_month(day_of_month);
-      data_sent.data().date.set_month(month);
-      data_sent.data().date.set_year(year);
-    }*/ 
+      impl_type impl;
+
+  protected:
+      data_send_t m_data;
   };
 
-  class GetSettingsCmd {
+  /* SetSettings writing the whole settings page, request is the page number followed by the page
+   * sent with security bytes as GetSettingsCmd, response is the same as of SetSettingsCmd
+   */
+  class SetSettingsPageCmd {
     public:
-      struct data_send_t {
-        UINT8 system_settings_page;
-      };
+      SetSettingsPageCmd() {
+        std::memset(static_cast<void *>(&m_data), 0, sizeof(m_data));
+      }
+
+      PACK(struct data_send_t {
+        UINT8 system_settings_page;
+        System_Settings_page0 page;
+      });
+
+      typedef SetSettingsCmd::data_t data_t;
+
+      void serialize(std::vector<uint8_t> &d, bool security = true) {
+        d = impl.serialize(m_data, security);
+      }
+
+      std::vector<uint8_t> serialize(bool security = true) {
+        return impl.serialize(m_data, security);
+      }
+
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size, bool security = true) const {
+        return impl.serialize(m_data, buf, size, security);
+      }
+
+      void deserialize(const std::vector<uint8_t> &d) {
+        impl.deserialize(d);
+      }
+
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
+      data_t getData() {
+        return impl.getType();
+      }
+
+      bool getStatus() {
+        return (getData().status.data == 170); 
+      }
+
+      void setPage(const UINT8 page) {
+        m_data.system_settings_page = page;
+      }
+
+      void setSettings(const System_Settings_page0 &page) {
+        // UINT14 assignment takes non-const reference
+        std::memcpy(static_cast<void *>(&m_data.page), &page, sizeof(page));
+      }
+
+      void setSettings(const SettingsCodec::Values &values) {
+        SettingsCodec::encode(values.data(), 1, &m_data.page);
+      }
+
+  public:
+      typedef Impl<SetSettingsPageCmd::data_send_t, SetSettingsPageCmd::data_t, CMD_SET_SETTINGS> impl_type;
+
+  private:
+      impl_type impl;
+
+  protected:
+      data_send_t m_data;
+  };
+
+  class GetSettingsCmd {
+    public:
+      struct data_send_t {
+        UINT8 system_settings_page;
+      };
 
       PACK(struct data_t {
         UINT8 system_settings_page;
@@ -775,10 +1400,33 @@ template <typename S, typename R>
         return impl.serialize(m_systemPage, true);
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(m_systemPage, buf, size, true);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t getData() {
         return impl.getType();
       }
@@ -787,14 +1435,22 @@ template <typename S, typename R>
         m_systemPage.system_settings_page = page;
       }
 
+  public:
+    typedef Impl<GetSettingsCmd::data_send_t, GetSettingsCmd::data_t, CMD_GET_SETTINGS> impl_type;
+
   private:
-    Impl<GetSettingsCmd::data_send_t, GetSettingsCmd::data_t, CMD_GET_SETTINGS> impl;
+    impl_type impl;
   
   protected:
     data_send_t m_systemPage;
   };
 
   class SetScheduleCmd {
+    public:
+      SetScheduleCmd() {
+        std::memset(static_cast<void *>(&m_data), 0, sizeof(m_data));
+      }
+
       PACK(struct data_send_t {
         UINT8 schedule_selection;
         Test_Schedule schedule_data;
@@ -805,17 +1461,40 @@ template <typename S, typename R>
       };
 
       void serialize(std::vector<uint8_t> &d) {
-        d = impl.serialize(); 
+        d = impl.serialize(m_data);
       }
 
       std::vector<uint8_t> serialize() {
-        return impl.serialize();
+        return impl.serialize(m_data);
+      }
+
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(m_data, buf, size);
       }
 
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t getData() {
         return impl.getType();
       }
@@ -824,13 +1503,209 @@ template <typename S, typename R>
         return (getData().status.data >= 0 && getData().status.data <= 6);
       }
 
+      // schedule slot 0 - 6
+      void setSelection(const UINT8 selection) {
+        m_data.schedule_selection = selection;
+      }
+
+      void setSchedule(const Test_Schedule &schedule) {
+        m_data.schedule_data = schedule;
+      }
+
+  public:
+    typedef Impl<SetScheduleCmd::data_send_t, SetScheduleCmd::data_t, CMD_SET_SCHEDULE> impl_type;
+
   private:
-    Impl<SetScheduleCmd::data_send_t, SetScheduleCmd::data_t, CMD_SET_SCHEDULE> impl;
+    impl_type impl;
+
+  protected:
+    data_send_t m_data;
   };
 
 /****************************************************
 ************** Time and date commands ***************
 ****************************************************/
+  // calendar date, month 1-12 and day 1-31
+  struct CivilDate {
+    int year;
+    unsigned month;
+    unsigned day;
+  };
+
+  /* closed-form conversions between calendar dates and days since 1970-01-01
+   * proleptic Gregorian calendar, no time zone database and no global state
+   */
+  class CivilTime {
+    public:
+      enum : int64_t {
+        seconds_per_day = 86400,
+      };
+
+      static constexpr int64_t daysFromCivil(int year, unsigned month, unsigned day) {
+        // years start in March so the leap day is the last day of the year
+        return eraDays(year - (month <= 2 ? 1 : 0), month, day);
+      }
+
+      static CivilDate civilFromDays(int64_t days) {
+        days += 719468;
+        const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        const unsigned doe = unsigned(days - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        CivilDate d;
+        d.day = doy - (153 * mp + 2) / 5 + 1;
+        d.month = mp < 10 ? mp + 3 : mp - 9;
+        d.year = int(int64_t(yoe) + era * 400 + (d.month <= 2 ? 1 : 0));
+        return d;
+      }
+
+      // 0 is Sunday
+      static constexpr unsigned weekdayFromDays(int64_t days) {
+        return unsigned(days >= -4 ? (days + 4) % 7 : (days + 5) % 7 + 6);
+      }
+
+      // floor division, correct also before 1970
+      static constexpr int64_t daysFromSeconds(int64_t seconds) {
+        return (seconds >= 0 ? seconds : seconds - (seconds_per_day - 1)) / seconds_per_day;
+      }
+
+      static constexpr bool isLeap(int year) {
+        return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+      }
+
+    private:
+      static constexpr int64_t eraDays(int y, unsigned m, unsigned d) {
+        return int64_t(y >= 0 ? y / 400 : (y - 399) / 400) * 146097
+          + yearOfEraDays(unsigned(y - (y >= 0 ? y / 400 : (y - 399) / 400) * 400), m, d) - 719468;
+      }
+
+      static constexpr int64_t yearOfEraDays(unsigned yoe, unsigned m, unsigned d) {
+        return yoe * 365 + yoe / 4 - yoe / 100 + (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+      }
+  };
+
+  /* UTC offset used for conversions of device local time
+   * fixed zone has a constant offset, local zone follows the system time zone including DST,
+   * its offsets are cached per UTC day in lock-free slots so conversions are safe from many threads
+   */
+  class TimeZone {
+    public:
+      // zone with constant offset east of UTC
+      static TimeZone fixed(std::chrono::seconds offset) {
+        return TimeZone(false, int32_t(offset.count()));
+      }
+
+      static TimeZone utc() {
+        return fixed(std::chrono::seconds(0));
+      }
+
+      // system local time zone
+      static TimeZone local() {
+        return TimeZone(true, 0);
+      }
+
+      // drop cached offsets of the local zone, call after the system time zone is changed
+      static void resetLocal() {
+        for (auto &slot : cache()) {
+          slot.store(0, std::memory_order_relaxed);
+        }
+      }
+
+      bool isLocal() const {
+        return m_local;
+      }
+
+      // offset in seconds at given UTC time
+      int32_t offset(int64_t utc_seconds) const {
+        return m_local ? localOffset(utc_seconds) : m_offset;
+      }
+
+      int64_t toLocal(int64_t utc_seconds) const {
+        return utc_seconds + offset(utc_seconds);
+      }
+
+      /* UTC time of the local time
+       * in the hour skipped by DST the time is shifted by the DST difference,
+       * repeated hour is resolved to its first occurrence
+       */
+      int64_t toUtc(int64_t local_seconds) const {
+        if (!m_local) {
+          return local_seconds - m_offset;
+        }
+        int64_t guess = local_seconds - localOffset(local_seconds);
+        int64_t utc = local_seconds - localOffset(guess);
+        int64_t earlier = local_seconds - localOffset(utc - 3600);
+        return earlier + localOffset(earlier) == local_seconds ? std::min(utc, earlier) : utc;
+      }
+
+    private:
+      enum : size_t {
+        day_slots = 1024,
+      };
+
+      enum : uint64_t {
+        // day slot of the day with offset change, offset of such day is queried from the system uncached
+        transition = 1 << 24,
+      };
+
+      // slot holds (day + 1) << 25 | transition | offset, 0 is empty
+      typedef std::array<std::atomic<uint64_t>, day_slots> Cache;
+
+      TimeZone(bool local, int32_t offset)
+      : m_local(local), m_offset(offset) {}
+
+      static Cache & cache() {
+        static Cache c = {};
+        return c;
+      }
+
+      static uint64_t pack(int64_t day, int32_t offset, uint64_t flags) {
+        return (uint64_t(day + 1) << 25) | flags | (uint32_t(offset) & 0xFFFFFF);
+      }
+
+      // sign extend 24 bit offset
+      static int32_t unpack(uint64_t v) {
+        return int32_t(uint32_t(v << 8)) >> 8;
+      }
+
+      /* offsets change at most once a day, so the UTC day is the cache key
+       * the few days with the change are not cached
+       */
+      static int32_t localOffset(int64_t utc_seconds) {
+        int64_t day = CivilTime::daysFromSeconds(utc_seconds);
+        std::atomic<uint64_t> &slot = cache()[size_t(day) % day_slots];
+        uint64_t v = slot.load(std::memory_order_relaxed);
+        if (v == 0 || int64_t(v >> 25) != day + 1) {
+          int64_t start = day * CivilTime::seconds_per_day;
+          int32_t first = systemOffset(start);
+          int32_t last = systemOffset(start + CivilTime::seconds_per_day - 1);
+          v = pack(day, first, first == last ? 0 : uint64_t(transition));
+          slot.store(v, std::memory_order_relaxed);
+        }
+        // offset changes during the day, not necessarily on the hour (e.g. Australia/Lord_Howe)
+        return (v & transition) == 0 ? unpack(v) : systemOffset(utc_seconds);
+      }
+
+      // reentrant query of the C library, on cache miss and for every value of a day with offset change
+      static int32_t systemOffset(int64_t utc_seconds) {
+        time_t t = time_t(utc_seconds);
+        tm local;
+#ifdef _MSC_VER
+        localtime_s(&local, &t);
+#else
+        localtime_r(&t, &local);
+#endif
+        int64_t local_seconds = CivilTime::daysFromCivil(local.tm_year + 1900, unsigned(local.tm_mon + 1), unsigned(local.tm_mday)) * CivilTime::seconds_per_day
+          + local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+        return int32_t(local_seconds - utc_seconds);
+      }
+
+    private:
+      bool m_local;
+      int32_t m_offset;
+  };
+
   // helper class for defining common struct for date/time and conversions
   class DateTimeBase {
     public:
@@ -859,38 +1734,38 @@ template <typename S, typename R>
         UINT8 date_century;
       });
 
-      // convert from timepoint to low level struct for sending data
-      data_send_t convertFromTimePoint(const std::chrono::system_clock::time_point & tim) {
-        data_send_t time;
-        time_t rawtime = std::chrono::system_clock::to_time_t(tim);
-        tm * tm = localtime(&rawtime);
+      /* convert from timepoint to low level struct for sending data
+       * device clock runs in the given zone, conversion is reentrant and doesn't use localtime()
+       */
+      static data_send_t convertFromTimePoint(const std::chrono::system_clock::time_point & tim, const TimeZone & tz = TimeZone::local()) {
+        int64_t local = tz.toLocal(std::chrono::duration_cast<std::chrono::seconds>(tim.time_since_epoch()).count());
+        int64_t days = CivilTime::daysFromSeconds(local);
+        int64_t secs = local - days * CivilTime::seconds_per_day;
+        CivilDate date = CivilTime::civilFromDays(days);
 
-        time.time_second = tm->tm_sec;
-        time.time_hour = tm->tm_hour;
-        time.time_minute = tm->tm_min;
+        data_send_t time;
+        time.time_second = int(secs % 60);
+        time.time_minute = int(secs / 60 % 60);
+        time.time_hour = int(secs / 3600);
         // day is from 1 - 31 (we expect 0 - 30)
-        time.date_day = tm->tm_mday - 1;
-        time.date_month = tm->tm_mon;
-        // tm_year is number of years from 1900
-        time.date_year = (tm->tm_year + 1900)% 100;
-        time.date_century = centuryFromYear(tm->tm_year + 1900); 
+        time.date_day = int(date.day - 1);
+        time.date_month = int(date.month - 1);
+        time.date_year = date.year % 100;
+        time.date_century = centuryFromYear(date.year);
         return time;
       }
 
-      std::chrono::system_clock::time_point convertToTimePoint(data_recv_t data) const {
-        tm time;
-        time.tm_sec = data.time_second.data;
-        time.tm_min = data.time_minute.data;
-        time.tm_hour = data.time_hour.data;
-        time.tm_mday = data.date_day.data + 1;
-        time.tm_wday = data.date_day_of_week.data;
-        time.tm_mon = data.date_month.data;
-        
-        time.tm_year = yearFromCentury(data.date_year.data, data.date_century.data) - 1900;
+      // day of week is ignored, out of range fields are normalised like mktime() does
+      static std::chrono::system_clock::time_point convertToTimePoint(data_recv_t data, const TimeZone & tz = TimeZone::local()) {
+        int year = yearFromCentury(data.date_year.data, data.date_century.data);
+        unsigned month = data.date_month.data;
+        year += month / 12;
+        month %= 12;
 
-        time_t t = mktime(&time);
+        int64_t days = CivilTime::daysFromCivil(year, month + 1, 1) + data.date_day.data;
+        int64_t local = days * CivilTime::seconds_per_day + data.time_hour.data * 3600 + data.time_minute.data * 60 + data.time_second.data;
 
-        return std::chrono::system_clock::from_time_t(t);
+        return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::seconds(tz.toUtc(local))));
       }
 
       // helper for converting year to century
@@ -915,6 +1790,133 @@ template <typename S, typename R>
       }
   };
 
+  /* decoding of System_Compressed_Date and System_Compressed_Time to seconds since epoch
+   * device stores two digit year, the century is given by the caller,
+   * batch functions take the raw UINT16 values of whole report archives
+   */
+  class CompressedDateTime {
+    public:
+      enum : size_t {
+        years = 128,
+        months = 16,
+      };
+
+      // local seconds since epoch of the date and time without time zone
+      static int64_t localSeconds(uint16_t date, uint16_t time, uint8_t century = 20) {
+        int year = DateTimeBase::yearFromCentury(0, century) + int((date >> 9) & 0x7F);
+        int64_t days = CivilTime::daysFromCivil(year, 1, 1) + monthTable()[leapKind(year)][(date >> 5) & 0xF] + (date & 0x1F);
+        return days * CivilTime::seconds_per_day + secondOfDay(time);
+      }
+
+      static int64_t toSeconds(System_Compressed_Date date, System_Compressed_Time time, const TimeZone & tz = TimeZone::local(), uint8_t century = 20) {
+        return tz.toUtc(localSeconds(date.data.data, time.data.data, century));
+      }
+
+      static std::chrono::system_clock::time_point toTimePoint(System_Compressed_Date date, System_Compressed_Time time, const TimeZone & tz = TimeZone::local(), uint8_t century = 20) {
+        return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::seconds(toSeconds(date, time, tz, century))));
+      }
+
+      /* convert n raw date and time values to seconds since epoch
+       * days come from year and cumulative month tables, the loop has no branches and no calls,
+       * local zone keeps the offset of the previous value while the per day cache confirms it
+       */
+      static void toSeconds(const uint16_t *dates, const uint16_t *times, size_t n, int64_t *out,
+        const TimeZone & tz = TimeZone::local(), uint8_t century = 20) {
+        int32_t year_days[years];
+        uint8_t year_leap[years];
+        yearTable(century, year_days, year_leap);
+        const int16_t (&month_days)[3][months] = monthTable();
+
+        for (size_t i = 0; i < n; i++) {
+          uint32_t d = dates[i];
+          uint32_t y = (d >> 9) & 0x7F;
+          int64_t days = int64_t(year_days[y]) + month_days[year_leap[y]][(d >> 5) & 0xF] + (d & 0x1F);
+          out[i] = days * CivilTime::seconds_per_day + secondOfDay(times[i]);
+        }
+        applyZone(out, n, tz);
+      }
+
+      static void toSeconds(const System_Compressed_Date *dates, const System_Compressed_Time *times, size_t n, int64_t *out,
+        const TimeZone & tz = TimeZone::local(), uint8_t century = 20) {
+        static_assert(sizeof(System_Compressed_Date) == sizeof(uint16_t) && sizeof(System_Compressed_Time) == sizeof(uint16_t),
+          "compressed date and time are expected to be plain UINT16");
+        toSeconds(reinterpret_cast<const uint16_t *>(dates), reinterpret_cast<const uint16_t *>(times), n, out, tz, century);
+      }
+
+      // start times of the reports, dates and times are interleaved with other fields
+      template <typename Report>
+      static void startSeconds(const Report *reports, size_t n, int64_t *out, const TimeZone & tz = TimeZone::local(), uint8_t century = 20) {
+        int32_t year_days[years];
+        uint8_t year_leap[years];
+        yearTable(century, year_days, year_leap);
+        const int16_t (&month_days)[3][months] = monthTable();
+
+        for (size_t i = 0; i < n; i++) {
+          uint32_t d = reports[i].start_date.data.data;
+          uint32_t y = (d >> 9) & 0x7F;
+          int64_t days = int64_t(year_days[y]) + month_days[year_leap[y]][(d >> 5) & 0xF] + (d & 0x1F);
+          out[i] = days * CivilTime::seconds_per_day + secondOfDay(reports[i].start_time.data.data);
+        }
+        applyZone(out, n, tz);
+      }
+
+    private:
+      // B4-B0 2 second units, B5-B10 minute, B11-B15 hour
+      static int64_t secondOfDay(uint32_t t) {
+        return ((t >> 11) & 0x1F) * 3600 + ((t >> 5) & 0x3F) * 60 + (t & 0x1F) * 2;
+      }
+
+      // row of the month table, 1 for leap year, 2 when the next year is leap
+      static uint8_t leapKind(int year) {
+        return CivilTime::isLeap(year) ? 1 : CivilTime::isLeap(year + 1) ? 2 : 0;
+      }
+
+      /* days before the month from the start of the year
+       * months 12 - 15 continue to the next year the same way convertToTimePoint() normalises them
+       */
+      static const int16_t (&monthTable())[3][months] {
+        static const int16_t table[3][months] = {
+          {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365, 396, 424, 455},
+          {0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335, 366, 397, 425, 456},
+          {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365, 396, 425, 456},
+        };
+        return table;
+      }
+
+      // days since epoch of 1st January of every two digit year of the century
+      static void yearTable(uint8_t century, int32_t (&days)[years], uint8_t (&leap)[years]) {
+        int base = DateTimeBase::yearFromCentury(0, century);
+        for (size_t y = 0; y < years; y++) {
+          days[y] = int32_t(CivilTime::daysFromCivil(base + int(y), 1, 1));
+          leap[y] = leapKind(base + int(y));
+        }
+      }
+
+      /* local seconds to UTC, consecutive values mostly share the offset so it is only verified,
+       * values in an hour after the offset change are resolved by toUtc()
+       */
+      static void applyZone(int64_t *seconds, size_t n, const TimeZone & tz) {
+        if (!tz.isLocal()) {
+          const int64_t offset = tz.offset(0);
+          for (size_t i = 0; i < n; i++) {
+            seconds[i] -= offset;
+          }
+          return;
+        }
+        int64_t offset = 0;
+        for (size_t i = 0; i < n; i++) {
+          int64_t utc = seconds[i] - offset;
+          int32_t current = tz.offset(utc);
+          if (utc + current != seconds[i] || tz.offset(utc - 3600) != current) {
+            utc = tz.toUtc(seconds[i]);
+            offset = seconds[i] - utc;
+          }
+          seconds[i] = utc;
+        }
+      }
+  };
+
   class SetTimeAndDateCmd : public DateTimeBase {
     public:
       
@@ -930,16 +1932,42 @@ template <typename S, typename R>
         return impl.serialize(m_time, security);
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size, bool security = false) const {
+        return impl.serialize(m_time, buf, size, security);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t getData() {
         return impl.getType();
       }
 
+  public:
+    typedef Impl<SetTimeAndDateCmd::data_send_t, SetTimeAndDateCmd::data_t, CMD_SET_DATE_AND_TIME> impl_type;
+
   private:
-    Impl<SetTimeAndDateCmd::data_send_t, SetTimeAndDateCmd::data_t, CMD_SET_DATE_AND_TIME> impl;
+    impl_type impl;
 
   protected:
     data_send_t m_time;
@@ -956,16 +1984,42 @@ template <typename S, typename R>
         return impl.serialize();
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_recv_t getData() const {
         return impl.getType();
       }
 
+  public:
+    typedef Impl<none, GetTimeAndDateCmd::data_recv_t, CMD_GET_DATE_AND_TIME> impl_type;
+
   private:
-    Impl<none, GetTimeAndDateCmd::data_recv_t, CMD_GET_DATE_AND_TIME> impl;
+    impl_type impl;
   };
 
   class PresetTimeAndDateCmd : public DateTimeBase {
@@ -983,16 +2037,42 @@ template <typename S, typename R>
         return impl.serialize(m_time);
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(m_time, buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t getData() {
         return impl.getType();
       }
 
+  public:
+    typedef Impl<PresetTimeAndDateCmd::data_send_t, PresetTimeAndDateCmd::data_t, CMD_PRESET_DATE_AND_TIME> impl_type;
+
   private:
-    Impl<PresetTimeAndDateCmd::data_send_t, PresetTimeAndDateCmd::data_t, CMD_PRESET_DATE_AND_TIME> impl;
+    impl_type impl;
   
   protected:
     data_send_t m_time;
@@ -1009,12 +2089,38 @@ template <typename S, typename R>
         return impl.serialize();
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
+  public:
+    typedef Impl<none, none, CMD_START_RTC> impl_type;
+
   private:
-    Impl<none, none, CMD_START_RTC> impl;
+    impl_type impl;
   };
 
   class ChangeRtcToPresetCmd {
@@ -1033,16 +2139,42 @@ template <typename S, typename R>
         return impl.serialize(security);
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size, bool security = false) const {
+        return impl.serialize(buf, size, security);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t getData() {
         return impl.getType();
       }
 
+  public:
+    typedef Impl<none, ChangeRtcToPresetCmd::data_t, CMD_CHANGE_RTC_TO_PRESET> impl_type;
+
   private:
-    Impl<none, ChangeRtcToPresetCmd::data_t, CMD_CHANGE_RTC_TO_PRESET> impl;
+    impl_type impl;
   };
 
   class TimeSyncCmd {
@@ -1056,12 +2188,38 @@ template <typename S, typename R>
         return impl.serialize();
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
+
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
       
+  public:
+    typedef Impl<none, none, CMD_TIME_SYNC> impl_type;
+
   private:
-    Impl<none, none, CMD_TIME_SYNC> impl;
+    impl_type impl;
   };
 
 /************************************************
@@ -1086,16 +2244,42 @@ class GetFlagsCmd {
         return impl.serialize();
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t getData() const {
         return impl.getType();
       }
 
+  public:
+    typedef Impl<none, GetFlagsCmd::data_t, CMD_GET_FLAGS> impl_type;
+
   private:
-    Impl<none, GetFlagsCmd::data_t, CMD_GET_FLAGS> impl;
+    impl_type impl;
   };
 
   class ResetFlagsCmd {
@@ -1109,12 +2293,38 @@ class GetFlagsCmd {
         return impl.serialize();
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
+  public:
+    typedef Impl<none, none, CMD_RESET_FLAGS> impl_type;
+
   private:
-    Impl<none, none, CMD_RESET_FLAGS> impl;
+    impl_type impl;
   };
 
 // GetReport can return 2 different responses thus we use this as base
@@ -1141,16 +2351,42 @@ class GetReportShortCmd : public GetReportCmd {
         return impl.serialize(m_idxShort);
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(m_idxShort, buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t_short getData() {
         return impl.getType();
       }
 
+  public:
+    typedef Impl<GetReportShortCmd::data_send_t, GetReportShortCmd::data_t_short, CMD_GET_REPORT> impl_type;
+
   private:
-    Impl<GetReportShortCmd::data_send_t, GetReportShortCmd::data_t_short, CMD_GET_REPORT> impl;
+    impl_type impl;
   
   protected:
     data_send_t m_idxShort;
@@ -1172,16 +2408,42 @@ class GetReportShortCmd : public GetReportCmd {
         return impl.serialize(m_idxLong);
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(m_idxLong, buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t_long getData() {
         return impl.getType();
       }
 
+  public:
+    typedef Impl<GetReportCmd::data_send_t, GetReportLongCmd::data_t_long, CMD_GET_REPORT> impl_type;
+
   private:
-    Impl<GetReportCmd::data_send_t, GetReportLongCmd::data_t_long, CMD_GET_REPORT> impl;
+    impl_type impl;
   
   protected:
     data_send_t m_idxLong;
@@ -1207,16 +2469,42 @@ class GetReportShortCmd : public GetReportCmd {
         return impl.serialize(m_data);
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(m_data, buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
       data_t getData() {
         return impl.getType();
       }
 
+  public:
+    typedef Impl<AcknowledgeReportCmd::data_send_t, AcknowledgeReportCmd::data_t, CMD_ACKNOWLEDGE_REPORT> impl_type;
+
   private:
-    Impl<AcknowledgeReportCmd::data_send_t, AcknowledgeReportCmd::data_t, CMD_ACKNOWLEDGE_REPORT> impl;
+    impl_type impl;
 
   protected:
     data_send_t m_data;
@@ -1233,11 +2521,37 @@ class GetReportShortCmd : public GetReportCmd {
         return impl.serialize();
       }
 
+      // serialize to the caller's buffer, returns frame size or 0 if buffer is too small
+      size_t serialize(uint8_t *buf, size_t size) const {
+        return impl.serialize(buf, size);
+      }
+
       void deserialize(const std::vector<uint8_t> &d) {
         impl.deserialize(d);
       }
 
+      void deserialize(const uint8_t *d, size_t size) {
+        impl.deserialize(d, size);
+      }
+
+      FrameStatus tryDeserialize(const uint8_t *d, size_t size) {
+        return impl.tryDeserialize(d, size);
+      }
+
+      // forget the last request and response, parameters are kept
+      void reset() {
+        impl.reset();
+      }
+
+      // heap memory held by the command
+      size_t capacity() const {
+        return impl.capacity();
+      }
+
+  public:
+    typedef Impl<none, none, CMD_GET_SYSTEM_STATUS_1> impl_type;
+
   private:
-    Impl<none, none, CMD_GET_SYSTEM_STATUS_1> impl;
+    impl_type impl;
   };
 };
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <repM3.h>
+
+namespace lgmc {
+
+  /* encodes requests of the whole poll cycle back-to-back to one contiguous arena
+   * index keeps node, command id, offset and size of each frame
+   * transport can submit the arena by single write and clear() releases all frames at once, capacity is kept
+   */
+  class RequestBatch {
+    public:
+      struct Entry {
+        NodeAddr node;
+        uint8_t id;
+        uint16_t size;
+        uint32_t offset;
+      };
+
+      RequestBatch() {}
+
+      explicit RequestBatch(size_t frames, size_t bytes_per_frame = 8) {
+        reserve(frames, bytes_per_frame);
+      }
+
+      void reserve(size_t frames, size_t bytes_per_frame = 8) {
+        m_entries.reserve(frames);
+        if (m_arena.size() < frames * bytes_per_frame) {
+          m_arena.resize(frames * bytes_per_frame);
+        }
+      }
+
+      // encode command object with its current parameters
+      template <typename Cmd>
+      bool add(NodeAddr node, const Cmd &cmd) {
+        uint8_t *buf = alloc(Cmd::impl_type::secure_frame_size);
+        return commit(node, Cmd::impl_type::command_id, cmd.serialize(buf, Cmd::impl_type::secure_frame_size));
+      }
+
+      // encode request of given command with payload
+      template <typename Cmd>
+      bool addRequest(NodeAddr node, const typename Cmd::impl_type::send_type &payload, bool security = false) {
+        typedef typename Cmd::impl_type impl_t;
+        uint8_t *buf = alloc(impl_t::secure_frame_size);
+        return commit(node, impl_t::command_id,
+          FrameCodec::encode(buf, impl_t::secure_frame_size, impl_t::command_id, &payload, impl_t::send_payload_size, security));
+      }
+
+      // request without payload is copied from compile-time frame
+      template <typename Cmd>
+      bool addRequest(NodeAddr node) {
+        typedef typename Cmd::impl_type impl_t;
+        static constexpr typename impl_t::frame_type frame = impl_t::requestFrame();
+        uint8_t *buf = alloc(frame.size());
+        std::memcpy(buf, frame.data(), frame.size());
+        return commit(node, impl_t::command_id, frame.size());
+      }
+
+      // drop all frames, arena and index capacity are kept for next cycle
+      void clear() {
+        m_entries.clear();
+        m_size = 0;
+      }
+
+      const uint8_t * data() const {
+        return m_arena.data();
+      }
+
+      // number of used bytes of the arena
+      size_t size() const {
+        return m_size;
+      }
+
+      size_t count() const {
+        return m_entries.size();
+      }
+
+      bool empty() const {
+        return m_entries.empty();
+      }
+
+      const std::vector<Entry> & entries() const {
+        return m_entries;
+      }
+
+      const Entry & entry(size_t i) const {
+        return m_entries[i];
+      }
+
+      const uint8_t * frame(size_t i) const {
+        return m_arena.data() + m_entries[i].offset;
+      }
+
+    private:
+      // space for the frame at the end of the arena, arena grows geometrically
+      uint8_t * alloc(size_t size) {
+        if (m_size + size > m_arena.size()) {
+          m_arena.resize(std::max(m_arena.size() * 2, m_size + size));
+        }
+        return &m_arena[m_size];
+      }
+
+      bool commit(NodeAddr node, uint8_t id, size_t size) {
+        if (size == 0) {
+          return false;
+        }
+        Entry e;
+        e.node = node;
+        e.id = id;
+        e.size = uint16_t(size);
+        e.offset = uint32_t(m_size);
+        m_entries.push_back(e);
+        m_size += size;
+        return true;
+      }
+
+    private:
+      std::vector<uint8_t> m_arena;
+      size_t m_size = 0;
+      std::vector<Entry> m_entries;
+  };
+}
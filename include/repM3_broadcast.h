@@ -0,0 +1,251 @@
+#pragma once
+
+#include <repM3_transport.h>
+#include <repM3_flag_index.h>
+
+#include <functional>
+
+namespace lgmc {
+
+  /* one request frame for many nodes, e.g. ResetFlags, StartRtc, ChangeRtcToPreset or TimeSync
+   * the frame is encoded once, acknowledgements are bits over node addresses,
+   * every retry round sends the same frame only to nodes with missing bit,
+   * a node the transport doesn't take now is sent later in the same round and doesn't lose a retry
+   */
+  class Broadcast : public Transport::Receiver {
+    public:
+      struct Config {
+        Config()
+        : timeout(500), retries(3) {}
+
+        // wait for acknowledgements of one round
+        std::chrono::milliseconds timeout;
+        // number of repeated frames to the node without response
+        int retries;
+      };
+
+      struct Stats {
+        uint64_t encodes = 0;
+        // frames queued to the transport including retries
+        uint64_t sent = 0;
+        uint64_t retried = 0;
+        uint64_t rounds = 0;
+        uint64_t acks = 0;
+        // nodes which answered but the acceptor refused the response
+        uint64_t refused = 0;
+        // nodes without acknowledgement after all rounds
+        uint64_t failed = 0;
+        // invalid frames, other command or unknown node
+        uint64_t unexpected = 0;
+      };
+
+      // decides whether the response acknowledges the command, e.g. by status byte of the payload
+      typedef std::function<bool(NodeAddr, const FrameView &)> Acceptor;
+
+      Broadcast(Transport &transport, const Config &config = Config())
+      : m_transport(transport), m_config(config) {}
+
+      // command without payload
+      template <typename Cmd>
+      void setCommand(bool security = false) {
+        static_assert(Cmd::impl_type::send_payload_size == 0, "request has payload");
+        setFrame(Cmd::impl_type::command_id, nullptr, 0, security);
+      }
+
+      template <typename Cmd>
+      void setCommand(const typename Cmd::impl_type::send_type &payload, bool security = false) {
+        setFrame(Cmd::impl_type::command_id, &payload, Cmd::impl_type::send_payload_size, security);
+      }
+
+      // new frame clears acknowledgements, nodes are kept
+      void setFrame(uint8_t id, const void *payload, size_t size, bool security = false) {
+        m_frame.resize(FrameCodec::frameSize(size, security));
+        m_frame.resize(FrameCodec::encode(m_frame.data(), m_frame.size(), id, payload, size, security));
+        m_id = id;
+        m_stats.encodes++;
+        reset();
+      }
+
+      void setAcceptor(Acceptor acceptor) {
+        m_acceptor = acceptor;
+      }
+
+      void addNode(NodeAddr node) {
+        grow(node);
+        m_targets[node / 64] |= bit(node);
+      }
+
+      void addNodes(const std::vector<NodeAddr> &nodes) {
+        for (NodeAddr node : nodes) {
+          addNode(node);
+        }
+      }
+
+      // forget acknowledgements to send the frame again
+      void reset() {
+        std::fill(m_acked.begin(), m_acked.end(), 0);
+        std::fill(m_refused.begin(), m_refused.end(), 0);
+        std::fill(m_round.begin(), m_round.end(), 0);
+        std::fill(m_attempts.begin(), m_attempts.end(), 0);
+        m_pending = 0;
+      }
+
+      /* send the frame to all nodes without acknowledgement and wait for responses,
+       * every node gets the frame at most retries + 1 times, returns false when some nodes are missing
+       */
+      bool run() {
+        while (true) {
+          collectMissing(true);
+          if (m_missing.empty() || !round()) {
+            break;
+          }
+        }
+        collectMissing(false);
+        m_stats.failed += m_missing.size();
+        return m_missing.empty();
+      }
+
+      bool acked(NodeAddr node) const {
+        return node / 64 < m_acked.size() && (m_acked[node / 64] & bit(node)) != 0;
+      }
+
+      bool refused(NodeAddr node) const {
+        return node / 64 < m_refused.size() && (m_refused[node / 64] & bit(node)) != 0;
+      }
+
+      // bit n of word n / 64 is node n
+      const std::vector<uint64_t> & ackBitmap() const {
+        return m_acked;
+      }
+
+      size_t ackCount() const {
+        size_t n = 0;
+        for (uint64_t w : m_acked) {
+          n += FlagIndex::popcount(w);
+        }
+        return n;
+      }
+
+      // nodes without any response, refused nodes are not included
+      std::vector<NodeAddr> missing() {
+        collectMissing(false);
+        return m_missing;
+      }
+
+      const std::vector<uint8_t> & frame() const {
+        return m_frame;
+      }
+
+      const Stats & stats() const {
+        return m_stats;
+      }
+
+      // late response of earlier round is an acknowledgement too
+      void onFrame(NodeAddr node, const uint8_t *data, size_t size) override {
+        FrameView frame(data, size);
+        const size_t w = node / 64;
+        if (w >= m_targets.size() || !(m_targets[w] & bit(node)) || !frame.isValid() || frame.id() != m_id
+          || ((m_acked[w] | m_refused[w]) & bit(node))) {
+          m_stats.unexpected++;
+          return;
+        }
+        if (m_round[w] & bit(node)) {
+          m_round[w] &= ~bit(node);
+          m_pending--;
+        }
+        if (m_acceptor && !m_acceptor(node, frame)) {
+          m_refused[w] |= bit(node);
+          m_stats.refused++;
+          return;
+        }
+        m_acked[w] |= bit(node);
+        m_stats.acks++;
+      }
+
+    private:
+      typedef std::chrono::steady_clock clock;
+
+      static uint64_t bit(NodeAddr node) {
+        return uint64_t(1) << (node % 64);
+      }
+
+      void grow(NodeAddr node) {
+        size_t words = node / 64 + 1;
+        if (words > m_targets.size()) {
+          m_targets.resize(words, 0);
+          m_acked.resize(words, 0);
+          m_refused.resize(words, 0);
+          m_round.resize(words, 0);
+          m_attempts.resize(words * 64, 0);
+        }
+      }
+
+      // targets & ~(acked | refused), optionally only nodes which didn't get the frame retries + 1 times
+      void collectMissing(bool sendable) {
+        m_missing.clear();
+        for (size_t w = 0; w < m_targets.size(); w++) {
+          uint64_t bits = m_targets[w] & ~(m_acked[w] | m_refused[w]);
+          while (bits != 0) {
+            NodeAddr node = NodeAddr(w * 64 + FlagIndex::lowestBit(bits));
+            bits &= bits - 1;
+            if (!sendable || int(m_attempts[node]) <= m_config.retries) {
+              m_missing.push_back(node);
+            }
+          }
+        }
+      }
+
+      /* send the frame to m_missing, nodes the transport doesn't take now are queued
+       * as responses free its window, the round ends timeout after the last send
+       * returns false when the transport didn't take any frame
+       */
+      bool round() {
+        m_stats.rounds++;
+        size_t next = 0;
+        auto deadline = clock::now() + m_config.timeout;
+        while (true) {
+          if (next < m_missing.size()) {
+            size_t n = m_transport.broadcast(&m_missing[next], m_missing.size() - next, m_frame.data(), m_frame.size());
+            for (size_t i = next; i < next + n; i++) {
+              NodeAddr node = m_missing[i];
+              m_round[node / 64] |= bit(node);
+              if (m_attempts[node]++ > 0) {
+                m_stats.retried++;
+              }
+            }
+            if (n > 0) {
+              deadline = clock::now() + m_config.timeout;
+            }
+            next += n;
+            m_pending += n;
+            m_stats.sent += n;
+          }
+          auto now = clock::now();
+          if ((m_pending == 0 && next == m_missing.size()) || now >= deadline) {
+            break;
+          }
+          m_transport.receive(*this, std::chrono::duration_cast<std::chrono::microseconds>(deadline - now));
+        }
+        std::fill(m_round.begin(), m_round.end(), 0);
+        m_pending = 0;
+        return next > 0;
+      }
+
+    private:
+      Transport &m_transport;
+      Config m_config;
+      Acceptor m_acceptor;
+      std::vector<uint8_t> m_frame;
+      uint8_t m_id = 0;
+      std::vector<uint64_t> m_targets;
+      std::vector<uint64_t> m_acked;
+      std::vector<uint64_t> m_refused;
+      // nodes of the current round without response
+      std::vector<uint64_t> m_round;
+      // frames sent to the node, index is node address
+      std::vector<uint16_t> m_attempts;
+      std::vector<NodeAddr> m_missing;
+      size_t m_pending = 0;
+      Stats m_stats;
+  };
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <repM3.h>
+
+namespace lgmc {
+
+  // tag identifying the command of dispatched response
+  template <typename Cmd>
+  struct ResponseOf {
+    typedef Cmd command_type;
+  };
+
+  /* routes incoming frames to the typed handler by command id and payload length
+   * Cmds are command classes (GetFlagsCmd, GetReportLongCmd, ...), the table is generated at compile time
+   * Handler is called as handler(ResponseOf<Cmd>(), const Cmd::impl_type::recv_type &payload, const FrameView &frame),
+   * generic template operator() can be used as a catch-all
+   */
+  template <typename Handler, typename... Cmds>
+  class ResponseDispatcher {
+    public:
+      explicit ResponseDispatcher(Handler &handler)
+      : m_handler(handler) {}
+
+      /* returns FRAME_OK when handler was called,
+       * frame validation error, FRAME_BAD_ID for unknown id or FRAME_BAD_LENGTH for unknown payload length
+       */
+      FrameStatus dispatch(const FrameView &frame) {
+        if (!frame.isValid()) {
+          return frame.status();
+        }
+        FrameStatus status = FRAME_BAD_ID;
+        for (const Entry &e : table()) {
+          if (e.id != frame.id()) {
+            continue;
+          }
+          if (e.payload_size == frame.payloadSize()) {
+            e.call(m_handler, frame);
+            return FRAME_OK;
+          }
+          status = FRAME_BAD_LENGTH;
+        }
+        return status;
+      }
+
+      FrameStatus dispatch(const uint8_t *data, size_t size) {
+        return dispatch(FrameView(data, size));
+      }
+
+    private:
+      typedef void (*call_t)(Handler &, const FrameView &);
+
+      struct Entry {
+        uint8_t id;
+        size_t payload_size;
+        call_t call;
+      };
+
+      enum : size_t { count = sizeof...(Cmds) };
+
+      template <typename Cmd>
+      static void call(Handler &handler, const FrameView &frame) {
+        typedef typename Cmd::impl_type::recv_type R;
+        // packed payloads are used in place, others are copied to be aligned
+        const R *p = frame.payloadAs<R>();
+        if (p != nullptr) {
+          handler(ResponseOf<Cmd>(), *p, frame);
+          return;
+        }
+        R r;
+        std::memcpy(static_cast<void *>(&r), frame.payload(), PayloadSize<R>::value);
+        handler(ResponseOf<Cmd>(), r, frame);
+      }
+
+      static constexpr size_t key(size_t id, size_t payload_size) {
+        return (id << 16) | payload_size;
+      }
+
+      // two commands sharing id must differ in response length
+      static constexpr bool uniqueKeys(const std::array<size_t, count> &keys) {
+        for (size_t i = 0; i < count; i++) {
+          for (size_t j = i + 1; j < count; j++) {
+            if (keys[i] == keys[j]) {
+              return false;
+            }
+          }
+        }
+        return true;
+      }
+
+      static_assert(uniqueKeys(std::array<size_t, count>{{ key(Cmds::impl_type::command_id, Cmds::impl_type::recv_payload_size)... }}),
+        "responses can't be distinguished by command id and payload length");
+
+      static const std::array<Entry, count> & table() {
+        static const std::array<Entry, count> t{{
+          { uint8_t(Cmds::impl_type::command_id), size_t(Cmds::impl_type::recv_payload_size), &call<Cmds> }...
+        }};
+        return t;
+      }
+
+    private:
+      Handler &m_handler;
+  };
+
+  // dispatcher for responses of every command in CommandNumber
+  // CMD_GET_REPORT short/long report and CMD_ACKNOWLEDGE_REPORT share id and are separated by length
+  template <typename Handler>
+  using CommandDispatcher = ResponseDispatcher<Handler,
+    GetSystemStatus1Cmd,
+    GetVersionCmd,
+    SetTimeAndDateCmd,
+    GetTimeAndDateCmd,
+    StartRtc,
+    GetSettingsCmd,
+    SetSettingsCmd,
+    PresetTimeAndDateCmd,
+    SetScheduleCmd,
+    ChangeRtcToPresetCmd,
+    GetReportShortCmd,
+    GetReportLongCmd,
+    AcknowledgeReportCmd,
+    GetFlagsCmd,
+    TimeSyncCmd,
+    ResetFlagsCmd>;
+}
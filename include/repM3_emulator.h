@@ -0,0 +1,357 @@
+#pragma once
+
+#include <repM3.h>
+
+#include <random>
+#include <unordered_map>
+
+namespace lgmc {
+
+  // state of the emulated RepM3 device
+  struct DeviceState {
+    enum : size_t {
+      report_slots = 64,
+      settings_pages = 4,
+      schedule_slots = 7,
+    };
+
+    DeviceState() {
+      std::memset(static_cast<void *>(this), 0, sizeof(*this));
+      version.fw_version_major = 1;
+      rtc_running = true;
+    }
+
+    GetVersionCmd::data_t version;
+    DateTimeBase::data_recv_t rtc;
+    DateTimeBase::data_send_t preset;
+    bool preset_valid;
+    bool rtc_running;
+    GetFlagsCmd::data_t flags;
+    // index 0 is the newest report
+    Long_Test_Report long_reports[report_slots];
+    Short_Test_Report short_reports[report_slots];
+    uint8_t long_count;
+    uint8_t short_count;
+    System_Settings_page0 settings[settings_pages];
+    Test_Schedule schedules[schedule_slots];
+    // device is switched off and doesn't answer
+    bool offline;
+    // seconds the clock is off after every set, e.g. faulty oscillator
+    int32_t rtc_error;
+    // requests with the report id are AcknowledgeReport, answered with green and red flags instead of the report
+    bool ack_reports;
+  };
+
+  /* in-process emulator of many RepM3 devices
+   * answers every command with the correctly framed response built from the device state,
+   * GetReport and AcknowledgeReport share the id and request, DeviceState::ack_reports selects the answer,
+   * responses can be dropped or corrupted with configured probability
+   */
+  class DeviceEmulator {
+    public:
+      enum : uint8_t {
+        // status of accepted set commands
+        status_ok = 170,
+        invalid_report = 0xFF,
+        long_report_offset = 128,
+      };
+
+      struct Config {
+        Config()
+        : drop_rate(0), corrupt_rate(0), seed(1) {}
+
+        // probability of not answering the request
+        double drop_rate;
+        // probability of flipped bit in the response
+        double corrupt_rate;
+        unsigned seed;
+      };
+
+      struct Stats {
+        uint64_t requests = 0;
+        uint64_t responses = 0;
+        uint64_t dropped = 0;
+        uint64_t corrupted = 0;
+        // invalid request frames, unknown command or node
+        uint64_t rejected = 0;
+      };
+
+      explicit DeviceEmulator(const Config &config = Config())
+      : m_config(config), m_random(config.seed) {}
+
+      // add device or replace its state
+      DeviceState & add(NodeAddr node, const DeviceState &state = DeviceState()) {
+        auto it = m_index.find(node);
+        if (it != m_index.end()) {
+          // UINT14 assignment takes non-const reference, state is plain data
+          DeviceState &d = m_devices[it->second];
+          std::memcpy(static_cast<void *>(&d), &state, sizeof(d));
+          return d;
+        }
+        m_index[node] = m_devices.size();
+        m_devices.push_back(state);
+        return m_devices.back();
+      }
+
+      void reserve(size_t devices) {
+        m_devices.reserve(devices);
+        m_index.reserve(devices);
+      }
+
+      // state of the device, nullptr for unknown node
+      DeviceState * device(NodeAddr node) {
+        auto it = m_index.find(node);
+        return it == m_index.end() ? nullptr : &m_devices[it->second];
+      }
+
+      size_t size() const {
+        return m_devices.size();
+      }
+
+      const Stats & stats() const {
+        return m_stats;
+      }
+
+      /* handle request frame of the node and write response frame to the buffer
+       * returns size of the response or 0 when the device doesn't answer
+       */
+      size_t respond(NodeAddr node, const uint8_t *request, size_t size, uint8_t *response, size_t capacity) {
+        m_stats.requests++;
+        DeviceState *s = device(node);
+        FrameView frame(request, size);
+        if (s == nullptr || !frame.isValid()) {
+          m_stats.rejected++;
+          return 0;
+        }
+        if (s->offline || chance(m_config.drop_rate)) {
+          m_stats.dropped++;
+          return 0;
+        }
+
+        size_t n = handle(*s, frame, response, capacity);
+        if (n == 0) {
+          m_stats.rejected++;
+          return 0;
+        }
+        if (chance(m_config.corrupt_rate)) {
+          // any byte between start and stop byte
+          response[1 + m_random() % (n - 2)] ^= uint8_t(1 << (m_random() % 8));
+          m_stats.corrupted++;
+        }
+        m_stats.responses++;
+        return n;
+      }
+
+      // emulator can be used as SimTransport responder through std::ref
+      size_t operator()(NodeAddr node, const uint8_t *request, size_t size, uint8_t *response, size_t capacity) {
+        return respond(node, request, size, response, capacity);
+      }
+
+    private:
+      bool chance(double p) {
+        return p > 0 && std::uniform_real_distribution<double>(0, 1)(m_random) < p;
+      }
+
+      // payload of the request of the command without security bytes, nullptr if size doesn't match
+      template <typename Cmd>
+      static const uint8_t * request(const FrameView &frame) {
+        const size_t expected = Cmd::impl_type::send_payload_size;
+        if (frame.payloadSize() == expected) {
+          return frame.payload();
+        }
+        if (frame.payloadSize() == expected + FrameCodec::security_size && frame.payload()[0] == 9 && frame.payload()[1] == 227) {
+          return frame.payload() + FrameCodec::security_size;
+        }
+        return nullptr;
+      }
+
+      template <typename Cmd>
+      static size_t reply(const typename Cmd::impl_type::recv_type &d, uint8_t *response, size_t capacity) {
+        return FrameCodec::encode(response, capacity, Cmd::impl_type::command_id, &d, Cmd::impl_type::recv_payload_size);
+      }
+
+      template <typename Cmd>
+      static size_t reply(uint8_t *response, size_t capacity) {
+        return FrameCodec::encode(response, capacity, Cmd::impl_type::command_id, nullptr, 0);
+      }
+
+      size_t handle(DeviceState &s, const FrameView &frame, uint8_t *response, size_t capacity) {
+        switch (frame.id()) {
+          case CMD_GET_SYSTEM_STATUS_1:
+            return reply<GetSystemStatus1Cmd>(response, capacity);
+
+          case CMD_GET_VERSION:
+            return reply<GetVersionCmd>(s.version, response, capacity);
+
+          case CMD_SET_DATE_AND_TIME: {
+            const uint8_t *p = request<SetTimeAndDateCmd>(frame);
+            if (p == nullptr) {
+              return 0;
+            }
+            setRtc(s, *reinterpret_cast<const DateTimeBase::data_send_t *>(p));
+            SetTimeAndDateCmd::data_t d{UINT8(status_ok)};
+            return reply<SetTimeAndDateCmd>(d, response, capacity);
+          }
+
+          case CMD_GET_DATE_AND_TIME:
+            return reply<GetTimeAndDateCmd>(s.rtc, response, capacity);
+
+          case CMD_START_RTC:
+            s.rtc_running = true;
+            s.flags.error_flags.setf0(false);
+            return reply<StartRtc>(response, capacity);
+
+          case CMD_GET_SETTINGS: {
+            const uint8_t *p = request<GetSettingsCmd>(frame);
+            if (p == nullptr || p[0] >= DeviceState::settings_pages) {
+              return 0;
+            }
+            GetSettingsCmd::data_t d;
+            d.system_settings_page = UINT8(p[0]);
+            d.page = s.settings[p[0]];
+            return reply<GetSettingsCmd>(d, response, capacity);
+          }
+
+          case CMD_SET_SETTINGS: {
+            // whole page is stored, page with compressed date is only acknowledged
+            const uint8_t *p = request<SetSettingsPageCmd>(frame);
+            if (p != nullptr && p[0] < DeviceState::settings_pages) {
+              std::memcpy(static_cast<void *>(&s.settings[p[0]]), p + 1, sizeof(System_Settings_page0));
+            } else if (request<SetSettingsCmd>(frame) == nullptr) {
+              return 0;
+            }
+            SetSettingsCmd::data_t d{UINT8(status_ok)};
+            return reply<SetSettingsCmd>(d, response, capacity);
+          }
+
+          case CMD_PRESET_DATE_AND_TIME: {
+            const uint8_t *p = request<PresetTimeAndDateCmd>(frame);
+            if (p == nullptr) {
+              return 0;
+            }
+            std::memcpy(static_cast<void *>(&s.preset), p, sizeof(s.preset));
+            s.preset_valid = true;
+            PresetTimeAndDateCmd::data_t d{UINT8(status_ok)};
+            return reply<PresetTimeAndDateCmd>(d, response, capacity);
+          }
+
+          case CMD_SET_SCHEDULE: {
+            const uint8_t *p = request<SetScheduleCmd>(frame);
+            if (p == nullptr) {
+              return 0;
+            }
+            // status is the selected slot, out of range selection is refused
+            uint8_t slot = p[0];
+            if (slot < DeviceState::schedule_slots) {
+              std::memcpy(static_cast<void *>(&s.schedules[slot]), p + 1, sizeof(Test_Schedule));
+            }
+            SetScheduleCmd::data_t d{UINT8(slot < DeviceState::schedule_slots ? slot : uint8_t(invalid_report))};
+            return reply<SetScheduleCmd>(d, response, capacity);
+          }
+
+          case CMD_CHANGE_RTC_TO_PRESET: {
+            ChangeRtcToPresetCmd::data_t d;
+            d.status = UINT8(s.preset_valid ? status_ok : 0);
+            d.result.data = s.preset_valid ? 1 : 0;
+            if (s.preset_valid) {
+              setRtc(s, s.preset);
+              s.preset_valid = false;
+            }
+            return reply<ChangeRtcToPresetCmd>(d, response, capacity);
+          }
+
+          // GetReport and AcknowledgeReport share the id and request layout
+          case CMD_GET_REPORT: {
+            const uint8_t *p = request<GetReportLongCmd>(frame);
+            if (p == nullptr) {
+              return 0;
+            }
+            return s.ack_reports ? acknowledge(s, p[0], response, capacity) : report(s, p[0], response, capacity);
+          }
+
+          case CMD_GET_FLAGS:
+            return reply<GetFlagsCmd>(s.flags, response, capacity);
+
+          case CMD_TIME_SYNC:
+            // bad_time_sync is the yellow flag 2
+            s.flags.warning_flags.setf2(false);
+            return reply<TimeSyncCmd>(response, capacity);
+
+          case CMD_RESET_FLAGS:
+            std::memset(static_cast<void *>(&s.flags), 0, sizeof(s.flags));
+            return reply<ResetFlagsCmd>(response, capacity);
+
+          default:
+            return 0;
+        }
+      }
+
+      void setRtc(DeviceState &s, const DateTimeBase::data_send_t &time) {
+        DateTimeBase::data_send_t t = time;
+        if (s.rtc_error != 0) {
+          int64_t days = CivilTime::daysFromCivil(DateTimeBase::yearFromCentury(t.date_year.data, t.date_century.data), t.date_month.data + 1, 1) + t.date_day.data;
+          int64_t local = days * CivilTime::seconds_per_day + t.time_hour.data * 3600 + t.time_minute.data * 60 + t.time_second.data;
+          t = DateTimeBase::convertFromTimePoint(std::chrono::system_clock::time_point(std::chrono::seconds(local + s.rtc_error)), TimeZone::utc());
+        }
+        s.rtc.time_second = t.time_second;
+        s.rtc.time_minute = t.time_minute;
+        s.rtc.time_hour = t.time_hour;
+        s.rtc.date_day = t.date_day;
+        s.rtc.date_month = t.date_month;
+        s.rtc.date_year = t.date_year;
+        s.rtc.date_century = t.date_century;
+      }
+
+      /* report index 0..63 from the newest report, 64 is the oldest one, +128 selects long report
+       * missing report is answered with index 0xFF
+       */
+      size_t report(const DeviceState &s, uint8_t index, uint8_t *response, size_t capacity) {
+        bool is_long = index >= long_report_offset;
+        int idx = is_long ? index - long_report_offset : index;
+        int count = is_long ? s.long_count : s.short_count;
+        if (idx == int(DeviceState::report_slots)) {
+          idx = count - 1;
+        }
+        bool valid = idx >= 0 && idx < count;
+
+        if (is_long) {
+          GetReportLongCmd::data_t_long d;
+          d.index = UINT8(valid ? index : uint8_t(invalid_report));
+          if (valid) {
+            d.rep = s.long_reports[idx];
+          } else {
+            std::memset(static_cast<void *>(&d.rep), 0, sizeof(d.rep));
+          }
+          return reply<GetReportLongCmd>(d, response, capacity);
+        }
+        GetReportShortCmd::data_t_short d;
+        d.index = UINT8(valid ? index : uint8_t(invalid_report));
+        if (valid) {
+          d.rep = s.short_reports[idx];
+        } else {
+          std::memset(static_cast<void *>(&d.rep), 0, sizeof(d.rep));
+        }
+        return reply<GetReportShortCmd>(d, response, capacity);
+      }
+
+      // acknowledged type of reports is no longer available, green pass and fail flags are cleared
+      size_t acknowledge(DeviceState &s, uint8_t index, uint8_t *response, size_t capacity) {
+        const bool is_long = index >= long_report_offset;
+        s.flags.info_flags.setf0(s.flags.info_flags.f0() && !is_long);
+        s.flags.info_flags.setf2(s.flags.info_flags.f2() && !is_long);
+        s.flags.info_flags.setf1(s.flags.info_flags.f1() && is_long);
+        s.flags.info_flags.setf3(s.flags.info_flags.f3() && is_long);
+        AcknowledgeReportCmd::data_t d;
+        d.green_flags.data = s.flags.info_flags;
+        d.red_flags.data = s.flags.error_flags;
+        return reply<AcknowledgeReportCmd>(d, response, capacity);
+      }
+
+    private:
+      Config m_config;
+      std::mt19937 m_random;
+      std::vector<DeviceState> m_devices;
+      std::unordered_map<NodeAddr, size_t> m_index;
+      Stats m_stats;
+  };
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <repM3_flag_index.h>
+
+#include <functional>
+
+namespace lgmc {
+
+  // flag of the node flipped between two consecutive GetFlags responses
+  struct FlagEvent {
+    NodeAddr node;
+    FlagIndex::Flag flag;
+    bool value;
+
+    // e.g. "node 417 red.short_test_failed 0->1"
+    std::string toString() const {
+      std::ostringstream os;
+      const char *name = FlagIndex::name(flag);
+      os << "node " << node << ' ' << FlagIndex::group(flag) << '.';
+      if (name != nullptr) {
+        os << name;
+      } else {
+        os << "f" << (flag < 48 ? flag % 16 : flag % 8);
+      }
+      os << ' ' << (value ? "0->1" : "1->0");
+      return os.str();
+    }
+  };
+
+  /* generates events only for flag bits flipped since the previous response of the node
+   * new flags are XORed with the previous word, cost depends on number of changes, not on fleet size
+   */
+  class FlagEventStream {
+    public:
+      typedef std::function<void(const FlagEvent &)> EventHandler;
+
+      struct Stats {
+        uint64_t updates = 0;
+        uint64_t events = 0;
+      };
+
+      /* mask selects published flags, e.g. without frequently changing system status bits
+       * first response of the node is compared with all flags cleared
+       */
+      explicit FlagEventStream(uint64_t mask = ~uint64_t(0))
+      : m_mask(mask) {}
+
+      void onEvent(EventHandler handler) {
+        m_handler = handler;
+      }
+
+      void setMask(uint64_t mask) {
+        m_mask = mask;
+      }
+
+      // returns number of generated events
+      size_t update(NodeAddr node, const GetFlagsCmd::data_t &flags) {
+        return update(node, FlagIndex::pack(flags));
+      }
+
+      size_t update(NodeAddr node, uint64_t flags) {
+        if (node >= m_flags.size()) {
+          m_flags.resize(size_t(node) + 1, 0);
+        }
+        m_stats.updates++;
+        uint64_t changed = (m_flags[node] ^ flags) & m_mask;
+        m_flags[node] = flags;
+        if (changed == 0) {
+          return 0;
+        }
+        size_t n = 0;
+        for (; changed != 0; changed &= changed - 1, n++) {
+          FlagIndex::Flag f = FlagIndex::Flag(FlagIndex::lowestBit(changed));
+          if (m_handler) {
+            m_handler(FlagEvent{node, f, ((flags >> f) & 1) != 0});
+          }
+        }
+        m_stats.events += n;
+        return n;
+      }
+
+      // previous flags of the node
+      uint64_t flags(NodeAddr node) const {
+        return node < m_flags.size() ? m_flags[node] : 0;
+      }
+
+      // forget the node, its next response is compared with cleared flags
+      void reset(NodeAddr node) {
+        if (node < m_flags.size()) {
+          m_flags[node] = 0;
+        }
+      }
+
+      const Stats & stats() const {
+        return m_stats;
+      }
+
+    private:
+      uint64_t m_mask;
+      EventHandler m_handler;
+      std::vector<uint64_t> m_flags;
+      Stats m_stats;
+  };
+}
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <repM3.h>
+
+namespace lgmc {
+
+  /* fleet-wide index of GetFlags responses
+   * every flag bit has dense bitmap over node addresses, queries are AND/OR/popcount over 64 bit words
+   */
+  class FlagIndex {
+    public:
+      /* flags of the GetFlags response as one 64 bit word
+       * green (info) flags are bits 0 - 15, yellow (warning) 16 - 31, red (error) 32 - 47,
+       * system status 48 - 55 and additional status 56 - 63
+       */
+      enum Flag : uint8_t {
+        LONG_TEST_PASS_REPORT_AVAIL = 0,
+        SHORT_TEST_PASS_REPORT_AVAIL = 1,
+        LONG_TEST_FAIL_REPORT_AVAIL = 2,
+        SHORT_TEST_FAIL_REPORT_AVAIL = 3,
+
+        LONG_TEST_REPORT_OVERWRITTEN = 16,
+        SHORT_TEST_REPORT_OVERWRITTEN = 17,
+        BAD_TIME_SYNC = 18,
+
+        RTC_NOT_RUNNING = 32,
+        LONG_TEST_FAILED = 33,
+        SHORT_TEST_FAILED = 34,
+        LED_OVER_VOLTAGE_TRIP = 35,
+        LED_LOW_LOAD = 36,
+        LED_OVER_CURRENT_TRIP = 37,
+        CELLS_ENABLE_FAILED = 38,
+
+        ANALOGUE_UP = 48,
+        PSU_UP = 49,
+        MAINS_ON = 50,
+        SWITCHED_MAINS_ON = 51,
+        CELLS_ENABLED = 52,
+        LOW_LED_CURRENT = 53,
+        LONG_TEST_RUNNING = 54,
+        SHORT_TEST_RUNNING = 55,
+
+        SHORT_TEST_TODAY = 56,
+        LONG_TEST_TODAY = 57,
+        SETTING_RESET_PENDING = 58,
+
+        FLAG_COUNT = 64,
+      };
+
+      enum : uint64_t {
+        green_mask = 0xFFFFull,
+        yellow_mask = 0xFFFFull << 16,
+        red_mask = 0xFFFFull << 32,
+      };
+
+      /* compound predicate, node matches when it has all flags of all(), at least one of any()
+       * and none of none()
+       */
+      class Query {
+        public:
+          Query & all(Flag f) {
+            m_all |= bit(f);
+            return *this;
+          }
+
+          Query & any(Flag f) {
+            m_any |= bit(f);
+            return *this;
+          }
+
+          Query & none(Flag f) {
+            m_none |= bit(f);
+            return *this;
+          }
+
+          // masks of Flag bits, e.g. red_mask
+          Query & allOf(uint64_t mask) {
+            m_all |= mask;
+            return *this;
+          }
+
+          Query & anyOf(uint64_t mask) {
+            m_any |= mask;
+            return *this;
+          }
+
+          Query & noneOf(uint64_t mask) {
+            m_none |= mask;
+            return *this;
+          }
+
+          // predicate on single flags word
+          bool matches(uint64_t flags) const {
+            return (flags & m_all) == m_all && (m_any == 0 || (flags & m_any) != 0) && (flags & m_none) == 0;
+          }
+
+        private:
+          friend class FlagIndex;
+          uint64_t m_all = 0;
+          uint64_t m_any = 0;
+          uint64_t m_none = 0;
+      };
+
+      static uint64_t bit(Flag f) {
+        return uint64_t(1) << f;
+      }
+
+      static uint64_t pack(const GetFlagsCmd::data_t &flags) {
+        return uint64_t(flags.info_flags.data)
+          | uint64_t(flags.warning_flags.data) << 16
+          | uint64_t(flags.error_flags.data) << 32
+          | uint64_t(flags.system_status_info.data) << 48
+          | uint64_t(flags.additional_status_info.data) << 56;
+      }
+
+      // name of the flag, nullptr for unnamed bit
+      static const char * name(Flag f) {
+        switch (f) {
+          case LONG_TEST_PASS_REPORT_AVAIL: return "long_test_pass_report_avail";
+          case SHORT_TEST_PASS_REPORT_AVAIL: return "short_test_pass_report_avail";
+          case LONG_TEST_FAIL_REPORT_AVAIL: return "long_test_fail_report_avail";
+          case SHORT_TEST_FAIL_REPORT_AVAIL: return "short_test_fail_report_avail";
+          case LONG_TEST_REPORT_OVERWRITTEN: return "long_test_report_overwritten";
+          case SHORT_TEST_REPORT_OVERWRITTEN: return "short_test_report_overwritten";
+          case BAD_TIME_SYNC: return "bad_time_sync";
+          case RTC_NOT_RUNNING: return "rtc_not_running";
+          case LONG_TEST_FAILED: return "long_test_failed";
+          case SHORT_TEST_FAILED: return "short_test_failed";
+          case LED_OVER_VOLTAGE_TRIP: return "led_over_voltage_trip";
+          case LED_LOW_LOAD: return "led_low_load";
+          case LED_OVER_CURRENT_TRIP: return "led_over_current_trip";
+          case CELLS_ENABLE_FAILED: return "cells_enable_failed";
+          case ANALOGUE_UP: return "analogue_up";
+          case PSU_UP: return "psu_up";
+          case MAINS_ON: return "mains_on";
+          case SWITCHED_MAINS_ON: return "switched_mains_on";
+          case CELLS_ENABLED: return "cells_enabled";
+          case LOW_LED_CURRENT: return "low_led_current";
+          case LONG_TEST_RUNNING: return "long_test_running";
+          case SHORT_TEST_RUNNING: return "short_test_running";
+          case SHORT_TEST_TODAY: return "short_test_today";
+          case LONG_TEST_TODAY: return "long_test_today";
+          case SETTING_RESET_PENDING: return "setting_reset_pending";
+          default: return nullptr;
+        }
+      }
+
+      // word of the flag in GetFlags response
+      static const char * group(Flag f) {
+        static const char * const groups[] = {"green", "yellow", "red", "system", "additional"};
+        return groups[f < 48 ? f / 16 : f < 56 ? 3 : 4];
+      }
+
+      // builtin is a library call without popcnt instruction, SWAR is faster then
+      static size_t popcount(uint64_t w) {
+#if defined(__POPCNT__)
+        return size_t(__builtin_popcountll(w));
+#else
+        w = w - ((w >> 1) & 0x5555555555555555ull);
+        w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+        w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+        return size_t((w * 0x0101010101010101ull) >> 56);
+#endif
+      }
+
+      // index of the lowest set bit, w is not 0
+      static unsigned lowestBit(uint64_t w) {
+#if defined(__GNUC__) || defined(__clang__)
+        return unsigned(__builtin_ctzll(w));
+#else
+        return unsigned(popcount((w & (~w + 1)) - 1));
+#endif
+      }
+
+      // store flags of the node, only changed bits are written to the bitmaps
+      void update(NodeAddr node, const GetFlagsCmd::data_t &flags) {
+        update(node, pack(flags));
+      }
+
+      void update(NodeAddr node, uint64_t flags) {
+        grow(node);
+        const size_t w = node / 64;
+        const uint64_t m = uint64_t(1) << (node % 64);
+        uint64_t changed = (m_flags[node] ^ flags) | ((m_known[w] & m) ? 0 : flags);
+        m_flags[node] = flags;
+        m_known[w] |= m;
+        while (changed != 0) {
+          unsigned f = lowestBit(changed);
+          changed &= changed - 1;
+          if (flags & (uint64_t(1) << f)) {
+            m_bitmaps[f][w] |= m;
+          } else {
+            m_bitmaps[f][w] &= ~m;
+          }
+        }
+      }
+
+      // forget the node, it doesn't match any query
+      void remove(NodeAddr node) {
+        if (!known(node)) {
+          return;
+        }
+        update(node, uint64_t(0));
+        m_known[node / 64] &= ~(uint64_t(1) << (node % 64));
+      }
+
+      bool known(NodeAddr node) const {
+        return node / 64 < m_known.size() && (m_known[node / 64] >> (node % 64)) & 1;
+      }
+
+      bool has(NodeAddr node, Flag f) const {
+        return known(node) && (m_flags[node] >> f) & 1;
+      }
+
+      // flags word of the node, 0 for unknown node
+      uint64_t flags(NodeAddr node) const {
+        return known(node) ? m_flags[node] : 0;
+      }
+
+      // number of indexed nodes
+      size_t size() const {
+        size_t n = 0;
+        for (uint64_t w : m_known) {
+          n += popcount(w);
+        }
+        return n;
+      }
+
+      // bitmap of the flag over node addresses, bit n of word n / 64 is node n
+      const std::vector<uint64_t> & bitmap(Flag f) const {
+        return m_bitmaps[f];
+      }
+
+      size_t count(Flag f) const {
+        size_t n = 0;
+        for (uint64_t w : m_bitmaps[f]) {
+          n += popcount(w);
+        }
+        return n;
+      }
+
+      std::vector<NodeAddr> nodes(Flag f) const {
+        return select(Query().all(f));
+      }
+
+      size_t count(const Query &q) const {
+        size_t n = 0;
+        for (size_t w = 0; w < m_known.size(); w++) {
+          n += popcount(word(q, w));
+        }
+        return n;
+      }
+
+      std::vector<NodeAddr> select(const Query &q) const {
+        std::vector<NodeAddr> result;
+        for (size_t w = 0; w < m_known.size(); w++) {
+          uint64_t bits = word(q, w);
+          while (bits != 0) {
+            result.push_back(NodeAddr(w * 64 + lowestBit(bits)));
+            bits &= bits - 1;
+          }
+        }
+        return result;
+      }
+
+    private:
+      // matching nodes of the word w of the bitmaps
+      uint64_t word(const Query &q, size_t w) const {
+        uint64_t r = m_known[w];
+        for (uint64_t m = q.m_all; m != 0 && r != 0; m &= m - 1) {
+          r &= m_bitmaps[lowestBit(m)][w];
+        }
+        if (q.m_any != 0) {
+          uint64_t any = 0;
+          for (uint64_t m = q.m_any; m != 0; m &= m - 1) {
+            any |= m_bitmaps[lowestBit(m)][w];
+          }
+          r &= any;
+        }
+        for (uint64_t m = q.m_none; m != 0 && r != 0; m &= m - 1) {
+          r &= ~m_bitmaps[lowestBit(m)][w];
+        }
+        return r;
+      }
+
+      void grow(NodeAddr node) {
+        if (node < m_flags.size()) {
+          return;
+        }
+        size_t words = node / 64 + 1;
+        m_flags.resize(words * 64, 0);
+        m_known.resize(words, 0);
+        for (auto &b : m_bitmaps) {
+          b.resize(words, 0);
+        }
+      }
+
+    private:
+      std::vector<uint64_t> m_flags;
+      std::vector<uint64_t> m_known;
+      std::array<std::vector<uint64_t>, FLAG_COUNT> m_bitmaps;
+  };
+}
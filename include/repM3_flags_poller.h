@@ -0,0 +1,276 @@
+#pragma once
+
+#include <repM3_transport.h>
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
+namespace lgmc {
+
+  /* fleet-wide GetFlags poller
+   * keeps up to concurrency requests in flight, concurrency is adapted to observed response latency (AIMD),
+   * nodes with green or red flags set are polled every cycle ahead of quiet nodes
+   */
+  class FlagsPoller : public Transport::Receiver {
+    public:
+      struct Config {
+        Config()
+        : min_concurrency(1), max_concurrency(256), initial_concurrency(16),
+          target_latency(50000), timeout(2000000), quiet_interval(1) {}
+
+        size_t min_concurrency;
+        size_t max_concurrency;
+        size_t initial_concurrency;
+        // concurrency grows while latency is below target and shrinks above it
+        std::chrono::microseconds target_latency;
+        std::chrono::microseconds timeout;
+        // quiet nodes are polled every quiet_interval cycles
+        unsigned quiet_interval;
+      };
+
+      struct Stats {
+        enum : size_t {
+          // cycle times kept for percentiles
+          cycle_window = 256,
+        };
+
+        uint64_t polls = 0;
+        uint64_t timeouts = 0;
+        // broken or late responses and nodes the transport didn't take for a whole timeout
+        uint64_t errors = 0;
+        uint64_t cycles = 0;
+        std::chrono::steady_clock::duration elapsed{};
+        // smoothed response latency
+        std::chrono::microseconds latency{0};
+        // ring of the last cycle_window cycle times, cycle n is at n % cycle_window
+        std::array<std::chrono::steady_clock::duration, cycle_window> cycle_times{};
+
+        double pollsPerSecond() const {
+          double s = std::chrono::duration<double>(elapsed).count();
+          return s > 0 ? polls / s : 0;
+        }
+
+        // percentile of the last cycle_window cycle times, p in 0..100
+        std::chrono::steady_clock::duration cycleTime(double p) const {
+          const size_t n = size_t(std::min<uint64_t>(cycles, cycle_window));
+          if (n == 0) {
+            return std::chrono::steady_clock::duration::zero();
+          }
+          std::array<std::chrono::steady_clock::duration, cycle_window> t(cycle_times);
+          size_t i = std::min(n - 1, size_t(p / 100 * n));
+          std::nth_element(t.begin(), t.begin() + i, t.begin() + n);
+          return t[i];
+        }
+      };
+
+      typedef std::function<void(NodeAddr, const GetFlagsCmd::data_t &)> FlagsHandler;
+
+      FlagsPoller(Transport &transport, const Config &config = Config())
+      : m_transport(transport), m_config(config) {
+        m_config.min_concurrency = std::max<size_t>(1, m_config.min_concurrency);
+        m_config.max_concurrency = std::max(m_config.min_concurrency, m_config.max_concurrency);
+        m_config.quiet_interval = std::max(1u, m_config.quiet_interval);
+        m_limit = double(std::min(std::max(m_config.initial_concurrency, m_config.min_concurrency), m_config.max_concurrency));
+      }
+
+      void onFlags(FlagsHandler handler) {
+        m_handler = handler;
+      }
+
+      void addNode(NodeAddr node) {
+        if (m_index.count(node)) {
+          return;
+        }
+        m_index[node] = m_nodes.size();
+        NodeState s;
+        s.node = node;
+        m_nodes.push_back(s);
+      }
+
+      // node has green or red flags set in the last response
+      bool isActive(NodeAddr node) const {
+        auto it = m_index.find(node);
+        return it != m_index.end() && m_nodes[it->second].active;
+      }
+
+      /* poll scheduled nodes once, returns duration of the cycle
+       * when nothing is in flight and the transport takes no request for timeout (e.g. link is down),
+       * the cycle ends and the nodes not sent are counted as errors
+       */
+      std::chrono::steady_clock::duration runCycle() {
+        auto start = clock::now();
+        schedule();
+        bool stalled = false;
+        clock::time_point stalled_since;
+        while (m_next < m_order.size() || m_in_flight > 0) {
+          auto now = clock::now();
+          expire(now);
+          while (m_next < m_order.size() && m_in_flight < concurrency()) {
+            if (!request(m_order[m_next], now)) {
+              break;
+            }
+            m_next++;
+          }
+          auto wait = m_deadlines.empty() ? std::chrono::microseconds(0)
+            : std::chrono::duration_cast<std::chrono::microseconds>(m_deadlines.front().deadline - now);
+          if (m_in_flight == 0 && m_next < m_order.size()) {
+            if (!stalled) {
+              stalled = true;
+              stalled_since = now;
+            } else if (now - stalled_since >= m_config.timeout) {
+              m_stats.errors += m_order.size() - m_next;
+              m_next = m_order.size();
+              break;
+            }
+            // late responses may free the transport, otherwise the wait is a back off
+            wait = std::chrono::duration_cast<std::chrono::microseconds>(stalled_since + m_config.timeout - now);
+          } else {
+            stalled = false;
+          }
+          m_transport.receive(*this, std::max(std::chrono::microseconds(0), wait));
+        }
+        auto duration = clock::now() - start;
+        m_stats.cycle_times[m_stats.cycles % Stats::cycle_window] = duration;
+        m_stats.cycles++;
+        m_stats.elapsed += duration;
+        return duration;
+      }
+
+      // current number of allowed requests in flight
+      size_t concurrency() const {
+        return size_t(m_limit);
+      }
+
+      const Stats & stats() const {
+        return m_stats;
+      }
+
+      void onFrame(NodeAddr node, const uint8_t *data, size_t size) override {
+        auto it = m_index.find(node);
+        if (it == m_index.end()) {
+          m_stats.errors++;
+          return;
+        }
+        NodeState &s = m_nodes[it->second];
+        if (!s.in_flight) {
+          // late response of timed out request
+          m_stats.errors++;
+          return;
+        }
+        s.in_flight = false;
+        m_in_flight--;
+
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - s.sent);
+        const GetFlagsCmd::data_t *flags = GetFlagsCmd::impl_type::payload(FrameView(data, size));
+        if (flags == nullptr) {
+          m_stats.errors++;
+          return;
+        }
+        m_stats.polls++;
+        s.active = flags->info_flags.data != 0 || flags->error_flags.data != 0;
+        adapt(latency);
+        if (m_handler) {
+          m_handler(node, *flags);
+        }
+      }
+
+    private:
+      typedef std::chrono::steady_clock clock;
+
+      struct NodeState {
+        NodeAddr node;
+        bool active = false;
+        bool in_flight = false;
+        uint32_t seq = 0;
+        clock::time_point sent;
+      };
+
+      struct Deadline {
+        clock::time_point deadline;
+        size_t node;
+        uint32_t seq;
+      };
+
+      // order of the cycle, active nodes first
+      void schedule() {
+        m_order.clear();
+        m_next = 0;
+        bool quiet_cycle = m_stats.cycles % m_config.quiet_interval == 0;
+        for (size_t i = 0; i < m_nodes.size(); i++) {
+          if (m_nodes[i].active) {
+            m_order.push_back(i);
+          }
+        }
+        if (quiet_cycle) {
+          for (size_t i = 0; i < m_nodes.size(); i++) {
+            if (!m_nodes[i].active) {
+              m_order.push_back(i);
+            }
+          }
+        }
+      }
+
+      bool request(size_t i, clock::time_point now) {
+        static constexpr GetFlagsCmd::impl_type::frame_type frame = GetFlagsCmd::impl_type::requestFrame();
+        NodeState &s = m_nodes[i];
+        if (s.in_flight) {
+          return true;
+        }
+        if (!m_transport.send(s.node, frame.data(), frame.size())) {
+          return false;
+        }
+        s.in_flight = true;
+        s.sent = now;
+        s.seq++;
+        m_in_flight++;
+        m_deadlines.push_back(Deadline{now + m_config.timeout, i, s.seq});
+        return true;
+      }
+
+      // deadlines are ordered by send time as timeout is constant
+      void expire(clock::time_point now) {
+        while (!m_deadlines.empty()) {
+          Deadline &d = m_deadlines.front();
+          NodeState &s = m_nodes[d.node];
+          if (s.in_flight && s.seq == d.seq) {
+            if (d.deadline > now) {
+              break;
+            }
+            s.in_flight = false;
+            m_in_flight--;
+            m_stats.timeouts++;
+            // timeout is a congestion signal
+            m_limit = std::max(double(m_config.min_concurrency), m_limit / 2);
+          }
+          m_deadlines.pop_front();
+        }
+      }
+
+      // additive increase by one per window of fast responses, multiplicative decrease on slow response
+      void adapt(std::chrono::microseconds latency) {
+        const double alpha = 0.125;
+        m_stats.latency = std::chrono::microseconds(int64_t(m_stats.latency.count() * (1 - alpha) + latency.count() * alpha));
+        if (latency <= m_config.target_latency) {
+          m_limit += 1.0 / m_limit;
+        } else {
+          m_limit *= 0.95;
+        }
+        m_limit = std::min(double(m_config.max_concurrency), std::max(double(m_config.min_concurrency), m_limit));
+      }
+
+    private:
+      Transport &m_transport;
+      Config m_config;
+      FlagsHandler m_handler;
+      std::vector<NodeState> m_nodes;
+      std::unordered_map<NodeAddr, size_t> m_index;
+      std::vector<size_t> m_order;
+      size_t m_next = 0;
+      size_t m_in_flight = 0;
+      std::deque<Deadline> m_deadlines;
+      double m_limit;
+      Stats m_stats;
+  };
+}
@@ -2,9 +2,49 @@
 
 #include <repM3.h>
 #include "rapidjson/pointer.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
 
 namespace lgmc {
 
+  /* streaming JSON encoder of the provider objects
+   * objects are written by rapidjson::Writer straight to the string buffer,
+   * buffer and writer are reused so no memory is allocated once the buffer has grown
+   */
+  class JsonEncoder {
+    public:
+      typedef rapidjson::Writer<rapidjson::StringBuffer> Writer;
+
+      explicit JsonEncoder(size_t capacity = 1024)
+      : m_buffer(nullptr, capacity), m_writer(m_buffer) {}
+
+      // encode object with write(Writer &) method, returned string is valid until next call
+      template <typename T>
+      const char * encode(const T & obj) {
+        obj.write(begin());
+        return str();
+      }
+
+      // start new document written by the caller
+      Writer & begin() {
+        m_buffer.Clear();
+        m_writer.Reset(m_buffer);
+        return m_writer;
+      }
+
+      const char * str() const {
+        return m_buffer.GetString();
+      }
+
+      size_t size() const {
+        return m_buffer.GetSize();
+      }
+
+    private:
+      rapidjson::StringBuffer m_buffer;
+      Writer m_writer;
+  };
+
 /**********************************************/
 /************** General Commands **************/
 /**********************************************/
@@ -17,16 +57,25 @@ class GetVersion : public GetVersionCmd {
       int release;
       int variant;
 
-      rapidjson::Value encode(rapidjson::Document::AllocatorType & a) {
+      rapidjson::Value encode(rapidjson::Document::AllocatorType & a) const {
         using namespace rapidjson;
         Value val(Type::kObjectType);
-        Pointer("/minor").Set(val, minor, a);
-        Pointer("/major").Set(val, major, a);
-        Pointer("/release").Set(val, release, a);
-        Pointer("/variant").Set(val, variant, a);
-        
+        val.AddMember("minor", minor, a);
+        val.AddMember("major", major, a);
+        val.AddMember("release", release, a);
+        val.AddMember("variant", variant, a);
         return val;
       }
+
+      template <typename Writer>
+      void write(Writer & w) const {
+        w.StartObject();
+        w.Key("minor"); w.Int(minor);
+        w.Key("major"); w.Int(major);
+        w.Key("release"); w.Int(release);
+        w.Key("variant"); w.Int(variant);
+        w.EndObject();
+      }
       
       std::string getAsString() {
         std::ostringstream os;
@@ -54,11 +103,72 @@ class GetVersion : public GetVersionCmd {
   /************** Settings and schedules **************/
   /**********************************************/
 
+  class GetSettings : public GetSettingsCmd {
+  public:
+    class Settings {
+    public:
+      int page;
+      // LED current in 62.5uA, voltage in 5mV and power in 1mW units
+      uint16_t currentMaintainedMode;
+      uint16_t voltageMaintainedMode;
+      uint16_t powerMaintainedMode;
+      uint16_t currentEmergencyMode;
+      uint16_t voltageEmergencyMode;
+      uint16_t powerEmergencyMode;
+      uint16_t testVoltageLowerLimit;
+      uint16_t testVoltageUpperLimit;
+
+      rapidjson::Value encode(rapidjson::Document::AllocatorType & a) const {
+        using namespace rapidjson;
+        Value val(Type::kObjectType);
+        val.AddMember("page", page, a);
+        val.AddMember("currentMaintainedMode", unsigned(currentMaintainedMode), a);
+        val.AddMember("voltageMaintainedMode", unsigned(voltageMaintainedMode), a);
+        val.AddMember("powerMaintainedMode", unsigned(powerMaintainedMode), a);
+        val.AddMember("currentEmergencyMode", unsigned(currentEmergencyMode), a);
+        val.AddMember("voltageEmergencyMode", unsigned(voltageEmergencyMode), a);
+        val.AddMember("powerEmergencyMode", unsigned(powerEmergencyMode), a);
+        val.AddMember("testVoltageLowerLimit", unsigned(testVoltageLowerLimit), a);
+        val.AddMember("testVoltageUpperLimit", unsigned(testVoltageUpperLimit), a);
+        return val;
+      }
+
+      template <typename Writer>
+      void write(Writer & w) const {
+        w.StartObject();
+        w.Key("page"); w.Int(page);
+        w.Key("currentMaintainedMode"); w.Uint(currentMaintainedMode);
+        w.Key("voltageMaintainedMode"); w.Uint(voltageMaintainedMode);
+        w.Key("powerMaintainedMode"); w.Uint(powerMaintainedMode);
+        w.Key("currentEmergencyMode"); w.Uint(currentEmergencyMode);
+        w.Key("voltageEmergencyMode"); w.Uint(voltageEmergencyMode);
+        w.Key("powerEmergencyMode"); w.Uint(powerEmergencyMode);
+        w.Key("testVoltageLowerLimit"); w.Uint(testVoltageLowerLimit);
+        w.Key("testVoltageUpperLimit"); w.Uint(testVoltageUpperLimit);
+        w.EndObject();
+      }
+    };
+
+    Settings getSettings() {
+      GetSettingsCmd::data_t d = getData();
+      Settings s;
+      s.page = d.system_settings_page.data;
+      s.currentMaintainedMode = d.page.current_maintained_mode.data;
+      s.voltageMaintainedMode = d.page.voltage_maintained_mode.data;
+      s.powerMaintainedMode = d.page.power_maintained_mode.data;
+      s.currentEmergencyMode = d.page.current_emergency_mode.data;
+      s.voltageEmergencyMode = d.page.voltage_emergency_mode.data;
+      s.powerEmergencyMode = d.page.power_emergency_mode.data;
+      s.testVoltageLowerLimit = d.page.test_voltage_lower_limit.data;
+      s.testVoltageUpperLimit = d.page.test_voltage_upper_limit.data;
+      return s;
+    }
+  };
+
   //TODO not prio now
-  //GetSettings
   //SetSettings
 
-  //TODO
+  // occurrences of the schedule are evaluated by ScheduleEngine in repM3_schedule.h
   class SetSchedule : public SetScheduleCmd {
   public:
     SetSchedule() = default;
@@ -97,7 +207,7 @@ class GetVersion : public GetVersionCmd {
   //  }
   };
 
-  //will be sent via FRC ack broadcast
+  //will be sent via FRC ack broadcast, see Broadcast in repM3_broadcast.h
   //class StartRtc : public BaseCommand {
   //class ChangeRtcToPresetCmd : public BaseCommand {
   //class TimeSync : public BaseCommand {
@@ -120,10 +230,53 @@ class GetVersion : public GetVersionCmd {
     bool isShortTestFail() const {
         return getData().info_flags.f3();
     }
+
+    // raw flag words, green are info, yellow warning and red error flags
+    class Flags {
+    public:
+      uint16_t green;
+      uint16_t yellow;
+      uint16_t red;
+      uint8_t systemStatus;
+      uint8_t additionalStatus;
+
+      rapidjson::Value encode(rapidjson::Document::AllocatorType & a) const {
+        using namespace rapidjson;
+        Value val(Type::kObjectType);
+        val.AddMember("green", unsigned(green), a);
+        val.AddMember("yellow", unsigned(yellow), a);
+        val.AddMember("red", unsigned(red), a);
+        val.AddMember("systemStatus", unsigned(systemStatus), a);
+        val.AddMember("additionalStatus", unsigned(additionalStatus), a);
+        return val;
+      }
+
+      template <typename Writer>
+      void write(Writer & w) const {
+        w.StartObject();
+        w.Key("green"); w.Uint(green);
+        w.Key("yellow"); w.Uint(yellow);
+        w.Key("red"); w.Uint(red);
+        w.Key("systemStatus"); w.Uint(systemStatus);
+        w.Key("additionalStatus"); w.Uint(additionalStatus);
+        w.EndObject();
+      }
+    };
+
+    Flags getFlags() const {
+      GetFlagsCmd::data_t d = getData();
+      Flags f;
+      f.green = d.info_flags.data;
+      f.yellow = d.warning_flags.data;
+      f.red = d.error_flags.data;
+      f.systemStatus = d.system_status_info.data;
+      f.additionalStatus = d.additional_status_info.data;
+      return f;
+    }
   };
 
   
-  //will be sent via FRC ack broadcast
+  //will be sent via FRC ack broadcast, see Broadcast in repM3_broadcast.h
   //class ResetFlagsCmd : public BaseCommand {
 
   class GetReportLong : public GetReportLongCmd {
@@ -150,15 +303,60 @@ class GetVersion : public GetVersionCmd {
         uint8_t exponents;
         uint8_t testFlags;
 
-        rapidjson::Value encode(rapidjson::Document::AllocatorType & a) {
+        // seconds since epoch
+        int64_t startSeconds() const {
+          return std::chrono::duration_cast<std::chrono::seconds>(startTime.time_since_epoch()).count();
+        }
+
+        rapidjson::Value encode(rapidjson::Document::AllocatorType & a) const {
           using namespace rapidjson;
           Value val(Type::kObjectType);
-          Pointer("/startTime").Set(val, "123", a);
-          //startTime directly as ss:mm:hh, .... or "ISO YYY-MM-DDThh:mm:ss" => will be stored to SQL DB?
-          Pointer("/bottomVoltage").Set(val, 3.0 , a); //TODO decode voltage
-          //...
+          val.AddMember("startTime", startSeconds(), a);
+          val.AddMember("testDuration", test_duration, a);
+          val.AddMember("cellStatus", int(cell_status), a);
+          val.AddMember("cellType", int(cell_type), a);
+          val.AddMember("startBottomVolts", unsigned(startBottomVols), a);
+          val.AddMember("startLoadVolts", unsigned(startLoadVolts), a);
+          val.AddMember("startLoadCurrent", unsigned(startLoadCurrent), a);
+          val.AddMember("testDurationAchieved", unsigned(testDurationAchieved), a);
+          val.AddMember("testDurationAchievedWithBothCells", unsigned(testDurationAchievedWithBothCells), a);
+          val.AddMember("endBottomVolts", unsigned(endBottomVolts), a);
+          val.AddMember("endTopVolts", unsigned(endTopVolts), a);
+          val.AddMember("endLoadVolts", unsigned(endLoadVolts), a);
+          val.AddMember("endLoadCurrent", unsigned(endLoadCurrent), a);
+          val.AddMember("bottomCellAmpHours", unsigned(bottomCellAmpHours), a);
+          val.AddMember("topCellAmpHours", unsigned(topCellAmpHours), a);
+          val.AddMember("bottomCellWattHours", unsigned(bottomCellWattHours), a);
+          val.AddMember("topCellWattHours", unsigned(topCellWattHours), a);
+          val.AddMember("exponents", unsigned(exponents), a);
+          val.AddMember("testFlags", unsigned(testFlags), a);
           return val;
         }
+
+        template <typename Writer>
+        void write(Writer & w) const {
+          w.StartObject();
+          w.Key("startTime"); w.Int64(startSeconds());
+          w.Key("testDuration"); w.Int(test_duration);
+          w.Key("cellStatus"); w.Int(cell_status);
+          w.Key("cellType"); w.Int(cell_type);
+          w.Key("startBottomVolts"); w.Uint(startBottomVols);
+          w.Key("startLoadVolts"); w.Uint(startLoadVolts);
+          w.Key("startLoadCurrent"); w.Uint(startLoadCurrent);
+          w.Key("testDurationAchieved"); w.Uint(testDurationAchieved);
+          w.Key("testDurationAchievedWithBothCells"); w.Uint(testDurationAchievedWithBothCells);
+          w.Key("endBottomVolts"); w.Uint(endBottomVolts);
+          w.Key("endTopVolts"); w.Uint(endTopVolts);
+          w.Key("endLoadVolts"); w.Uint(endLoadVolts);
+          w.Key("endLoadCurrent"); w.Uint(endLoadCurrent);
+          w.Key("bottomCellAmpHours"); w.Uint(bottomCellAmpHours);
+          w.Key("topCellAmpHours"); w.Uint(topCellAmpHours);
+          w.Key("bottomCellWattHours"); w.Uint(bottomCellWattHours);
+          w.Key("topCellWattHours"); w.Uint(topCellWattHours);
+          w.Key("exponents"); w.Uint(exponents);
+          w.Key("testFlags"); w.Uint(testFlags);
+          w.EndObject();
+        }
     };
 
     //index from 0 - 63, 64 used for getting oldest report
@@ -169,28 +367,19 @@ class GetVersion : public GetVersionCmd {
 
     //getting result
     LongReport getReport() {
-      data_t_long report = cmdLong.getData();
+      data_t_long report = getData();
       if (isReportValid(report) != true) {
         return LongReport{};
       }
       LongReport r;
 
-      DateTimeBase dt;
-      DateTimeBase::data_recv_t data;
-      data.date_year = report.rep.start_date.year();
-      data.date_month = report.rep.start_date.month();
-      data.date_day = report.rep.start_date.day_of_month();
-      data.time_hour = report.rep.start_time.hour();
-      data.time_minute = report.rep.start_time.minute();
-      data.time_second = report.rep.start_time.seconds();
-
-      r.startTime = dt.convertToTimePoint(data);
+      r.startTime = CompressedDateTime::toTimePoint(report.rep.start_date, report.rep.start_time);
       
       r.test_duration = report.rep.test_duration.value();
       r.cell_status = report.rep.start_cell_mode.cell_status_val();
       r.cell_type = report.rep.start_cell_mode.cell_type_val();
       r.startBottomVols = report.rep.start_bottom_cell_volts.data;
-
+      r.startLoadVolts = report.rep.start_load_volts.data;
       r.startLoadCurrent = report.rep.start_load_current.data;
       r.testDurationAchieved = report.rep.test_duration_achieved.data;
       r.testDurationAchievedWithBothCells = report.rep.test_duration_achieved_with_both_cells.data;
@@ -209,7 +398,6 @@ class GetVersion : public GetVersionCmd {
     }
 
     private:
-      GetReportLongCmd cmdLong;
       const int longReportOffset = 128;
 
     private:
@@ -222,7 +410,48 @@ class GetVersion : public GetVersionCmd {
   class GetReportShort : public GetReportShortCmd {
   public:
     class ShortReport {
-      //....
+      public:
+        std::chrono::system_clock::time_point startTime;
+        BATTSTATUS8::charge_status cell_status;
+        BATTSTATUS8::cell_type cell_type;
+        uint16_t bottomCellVolts;
+        uint16_t topCellVolts;
+        uint16_t loadVolts;
+        uint16_t loadCurrent;
+        uint8_t testFlags;
+
+        // seconds since epoch
+        int64_t startSeconds() const {
+          return std::chrono::duration_cast<std::chrono::seconds>(startTime.time_since_epoch()).count();
+        }
+
+        rapidjson::Value encode(rapidjson::Document::AllocatorType & a) const {
+          using namespace rapidjson;
+          Value val(Type::kObjectType);
+          val.AddMember("startTime", startSeconds(), a);
+          val.AddMember("cellStatus", int(cell_status), a);
+          val.AddMember("cellType", int(cell_type), a);
+          val.AddMember("bottomCellVolts", unsigned(bottomCellVolts), a);
+          val.AddMember("topCellVolts", unsigned(topCellVolts), a);
+          val.AddMember("loadVolts", unsigned(loadVolts), a);
+          val.AddMember("loadCurrent", unsigned(loadCurrent), a);
+          val.AddMember("testFlags", unsigned(testFlags), a);
+          return val;
+        }
+
+        template <typename Writer>
+        void write(Writer & w) const {
+          w.StartObject();
+          w.Key("startTime"); w.Int64(startSeconds());
+          w.Key("cellStatus"); w.Int(cell_status);
+          w.Key("cellType"); w.Int(cell_type);
+          w.Key("bottomCellVolts"); w.Uint(bottomCellVolts);
+          w.Key("topCellVolts"); w.Uint(topCellVolts);
+          w.Key("loadVolts"); w.Uint(loadVolts);
+          w.Key("loadCurrent"); w.Uint(loadCurrent);
+          w.Key("testFlags"); w.Uint(testFlags);
+          w.EndObject();
+        }
     };
 
     //index from 0 - 63, 64 used for getting oldest report
@@ -231,14 +460,23 @@ class GetVersion : public GetVersionCmd {
     }
 
     ShortReport getShortReport() {
-      data_t_short report = cmdShort.getData();
+      data_t_short report = getData();
       if (isReportValid(report) != true) {
         return ShortReport{};
       }
-      return ShortReport{};
+      ShortReport r;
+
+      r.startTime = CompressedDateTime::toTimePoint(report.rep.start_date, report.rep.start_time);
+      r.cell_status = report.rep.start_cell_mode.cell_status_val();
+      r.cell_type = report.rep.start_cell_mode.cell_type_val();
+      r.bottomCellVolts = report.rep.bottom_cell_volts.data;
+      r.topCellVolts = report.rep.top_cell_volts.data;
+      r.loadVolts = report.rep.load_volts.data;
+      r.loadCurrent = report.rep.load_current.data;
+      r.testFlags = report.rep.test_flags.data;
+
+      return r;
     }
-  private:
-    GetReportShortCmd cmdShort;
 
   private:
     template<typename T>
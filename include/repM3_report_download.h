@@ -0,0 +1,297 @@
+#pragma once
+
+#include <repM3_transport.h>
+
+#include <functional>
+#include <unordered_map>
+
+namespace lgmc {
+
+  /* pipelined download of long or short test reports from many nodes
+   * keeps a window of outstanding GetReport requests per node and matches responses by echoed index,
+   * download of the node stops at first invalid (0xFF) report
+   */
+  class ReportDownloader : public Transport::Receiver {
+    public:
+      enum ReportType {
+        LONG_REPORT,
+        SHORT_REPORT,
+      };
+
+      struct Config {
+        Config()
+        : window(4), first(0), last(63), timeout(2000), retries(2) {}
+
+        // outstanding requests per node
+        size_t window;
+        // report indexes first..last, 64 is the oldest report
+        int first;
+        int last;
+        std::chrono::milliseconds timeout;
+        // number of repeated requests after timeout
+        int retries;
+      };
+
+      struct Stats {
+        uint64_t requests = 0;
+        uint64_t reports = 0;
+        uint64_t timeouts = 0;
+        // reports not received after all retries
+        uint64_t lost = 0;
+        // responses not matching any outstanding request or broken
+        uint64_t unexpected = 0;
+        std::chrono::steady_clock::duration elapsed{};
+
+        double reportsPerSecond() const {
+          double s = std::chrono::duration<double>(elapsed).count();
+          return s > 0 ? reports / s : 0;
+        }
+      };
+
+      typedef std::function<void(NodeAddr, const GetReportLongCmd::data_t_long &)> LongReportHandler;
+      typedef std::function<void(NodeAddr, const GetReportShortCmd::data_t_short &)> ShortReportHandler;
+
+      ReportDownloader(Transport &transport, const Config &config = Config())
+      : m_transport(transport), m_config(config) {
+        m_config.first = std::max(0, std::min<int>(m_config.first, max_index));
+        m_config.last = std::max(m_config.first, std::min<int>(m_config.last, max_index));
+        m_config.window = std::max<size_t>(1, m_config.window);
+      }
+
+      void onLongReport(LongReportHandler handler) {
+        m_long_handler = handler;
+      }
+
+      void onShortReport(ShortReportHandler handler) {
+        m_short_handler = handler;
+      }
+
+      // schedule download of reports of the node
+      void add(NodeAddr node, ReportType type) {
+        NodeState s;
+        s.node = node;
+        s.type = type;
+        s.next = m_config.first;
+        m_index[node] = m_nodes.size();
+        m_nodes.push_back(s);
+      }
+
+      /* one step: send requests up to the window, receive responses and handle timeouts
+       * returns false when all downloads are finished
+       */
+      bool step(std::chrono::microseconds wait = std::chrono::microseconds(1000)) {
+        if (!m_started) {
+          m_started = true;
+          m_start = clock::now();
+        }
+        auto now = clock::now();
+        bool active = false;
+        for (NodeState &s : m_nodes) {
+          expire(s, now);
+          fill(s, now);
+          active |= !s.finished();
+        }
+        if (active) {
+          m_transport.receive(*this, wait);
+        }
+        m_stats.elapsed = clock::now() - m_start;
+        return active;
+      }
+
+      // download all scheduled reports
+      const Stats & run() {
+        while (step()) {
+        }
+        return m_stats;
+      }
+
+      const Stats & stats() const {
+        return m_stats;
+      }
+
+      void onFrame(NodeAddr node, const uint8_t *data, size_t size) override {
+        auto it = m_index.find(node);
+        FrameView frame(data, size);
+        if (it == m_index.end() || !frame.isValid(CMD_GET_REPORT)) {
+          m_stats.unexpected++;
+          return;
+        }
+        NodeState &s = m_nodes[it->second];
+
+        uint8_t index = 0;
+        if (s.type == LONG_REPORT) {
+          const GetReportLongCmd::data_t_long *r = GetReportLongCmd::impl_type::payload(frame);
+          if (r == nullptr || !accept(s, r->index)) {
+            return;
+          }
+          index = r->index;
+          if (index != invalid_index && m_long_handler) {
+            m_long_handler(node, *r);
+          }
+        } else {
+          const GetReportShortCmd::data_t_short *r = GetReportShortCmd::impl_type::payload(frame);
+          if (r == nullptr || !accept(s, r->index)) {
+            return;
+          }
+          index = r->index;
+          if (index != invalid_index && m_short_handler) {
+            m_short_handler(node, *r);
+          }
+        }
+
+        if (index == invalid_index) {
+          // no more reports, lower outstanding indexes are still awaited
+          s.stopped = true;
+        } else {
+          m_stats.reports++;
+        }
+      }
+
+    private:
+      typedef std::chrono::steady_clock clock;
+
+      enum {
+        max_index = 64,
+        invalid_index = 0xFF,
+        long_report_offset = 128,
+      };
+
+      struct NodeState {
+        NodeAddr node;
+        ReportType type;
+        // next index to be requested
+        int next;
+        bool stopped = false;
+        // bit per outstanding index
+        uint64_t outstanding = 0;
+        // oldest report (index 64) doesn't fit to the mask
+        bool outstanding_oldest = false;
+        clock::time_point deadline[max_index + 1];
+        uint8_t retries[max_index + 1] = {};
+
+        size_t pending() const {
+          return bitCount(outstanding) + (outstanding_oldest ? 1 : 0);
+        }
+
+        bool finished() const {
+          return pending() == 0 && stopped;
+        }
+      };
+
+      static size_t bitCount(uint64_t v) {
+        size_t n = 0;
+        for (; v; v &= v - 1) {
+          n++;
+        }
+        return n;
+      }
+
+      bool isOutstanding(const NodeState &s, int idx) const {
+        return idx == max_index ? s.outstanding_oldest : ((s.outstanding >> idx) & 1) != 0;
+      }
+
+      void setOutstanding(NodeState &s, int idx, bool val) {
+        if (idx == max_index) {
+          s.outstanding_oldest = val;
+        } else if (val) {
+          s.outstanding |= uint64_t(1) << idx;
+        } else {
+          s.outstanding &= ~(uint64_t(1) << idx);
+        }
+      }
+
+      /* response matches outstanding request
+       * invalid report doesn't echo the index, reports are stored from index 0 so it answers the highest outstanding index
+       */
+      bool accept(NodeState &s, uint8_t index) {
+        if (index == invalid_index) {
+          if (s.pending() == 0) {
+            m_stats.unexpected++;
+            return false;
+          }
+          if (s.outstanding_oldest) {
+            s.outstanding_oldest = false;
+          } else {
+            int highest = 63;
+            while (!isOutstanding(s, highest)) {
+              highest--;
+            }
+            setOutstanding(s, highest, false);
+          }
+          return true;
+        }
+        int idx = index >= long_report_offset ? index - long_report_offset : index;
+        if (idx > max_index || !isOutstanding(s, idx)) {
+          m_stats.unexpected++;
+          return false;
+        }
+        setOutstanding(s, idx, false);
+        return true;
+      }
+
+      // returns false when the transport doesn't take the request now
+      bool request(NodeState &s, int idx, clock::time_point now) {
+        GetReportCmd::data_send_t d;
+        if (s.type == LONG_REPORT) {
+          d.report_index = uint8_t(idx + long_report_offset);
+          GetReportLongCmd::impl_type::frame_type frame = GetReportLongCmd::impl_type::encode(d);
+          if (!m_transport.send(s.node, frame.data(), frame.size())) {
+            return false;
+          }
+        } else {
+          d.report_index = uint8_t(idx);
+          GetReportShortCmd::impl_type::frame_type frame = GetReportShortCmd::impl_type::encode(d);
+          if (!m_transport.send(s.node, frame.data(), frame.size())) {
+            return false;
+          }
+        }
+        m_stats.requests++;
+        setOutstanding(s, idx, true);
+        s.deadline[idx] = now + m_config.timeout;
+        return true;
+      }
+
+      void fill(NodeState &s, clock::time_point now) {
+        while (!s.stopped && s.next <= m_config.last && s.pending() < m_config.window) {
+          if (!request(s, s.next, now)) {
+            // transport is busy
+            return;
+          }
+          s.next++;
+        }
+        if (s.pending() == 0 && s.next > m_config.last) {
+          s.stopped = true;
+        }
+      }
+
+      /* expired index is requested again with new deadline,
+       * when the transport is busy it stays outstanding and the next step tries again without using a retry
+       */
+      void expire(NodeState &s, clock::time_point now) {
+        for (int idx = m_config.first; idx <= m_config.last && s.pending() > 0; idx++) {
+          if (!isOutstanding(s, idx) || s.deadline[idx] > now) {
+            continue;
+          }
+          if (s.retries[idx] >= m_config.retries) {
+            m_stats.timeouts++;
+            m_stats.lost++;
+            setOutstanding(s, idx, false);
+          } else if (request(s, idx, now)) {
+            m_stats.timeouts++;
+            s.retries[idx]++;
+          }
+        }
+      }
+
+    private:
+      Transport &m_transport;
+      Config m_config;
+      std::vector<NodeState> m_nodes;
+      std::unordered_map<NodeAddr, size_t> m_index;
+      LongReportHandler m_long_handler;
+      ShortReportHandler m_short_handler;
+      Stats m_stats;
+      bool m_started = false;
+      clock::time_point m_start;
+  };
+}
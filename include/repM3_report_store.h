@@ -0,0 +1,333 @@
+#pragma once
+
+#include <repM3.h>
+
+namespace lgmc {
+
+  // min, max and mean of the column
+  struct ColumnSummary {
+    uint32_t min;
+    uint32_t max;
+    double mean;
+    size_t count;
+  };
+
+  /* scans over contiguous columns of 8 and 16 bit values
+   * SSE2 processes 16 or 8 values per instruction, the rest is handled by scalar loops
+   */
+  class ColumnScan {
+    public:
+      static ColumnSummary summary(const uint8_t *data, size_t size) {
+        uint64_t sum = 0;
+        uint8_t lo = 0xFF;
+        uint8_t hi = 0;
+        size_t i = 0;
+#ifdef LGMC_SSE2
+        if (size >= 16) {
+          const __m128i zero = _mm_setzero_si128();
+          __m128i vmin = _mm_set1_epi8(char(0xFF));
+          __m128i vmax = zero;
+          __m128i acc = zero;
+          for (; i + 16 <= size; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            vmin = _mm_min_epu8(vmin, v);
+            vmax = _mm_max_epu8(vmax, v);
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+          }
+          uint64_t sums[2];
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(sums), acc);
+          sum = sums[0] + sums[1];
+          uint8_t mins[16];
+          uint8_t maxs[16];
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(mins), vmin);
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(maxs), vmax);
+          for (int k = 0; k < 16; k++) {
+            lo = std::min(lo, mins[k]);
+            hi = std::max(hi, maxs[k]);
+          }
+        }
+#endif
+        for (; i < size; i++) {
+          lo = std::min(lo, data[i]);
+          hi = std::max(hi, data[i]);
+          sum += data[i];
+        }
+        return makeSummary(lo, hi, sum, size);
+      }
+
+      static ColumnSummary summary(const uint16_t *data, size_t size) {
+        uint64_t sum = 0;
+        uint16_t lo = 0xFFFF;
+        uint16_t hi = 0;
+        size_t i = 0;
+#ifdef LGMC_SSE2
+        if (size >= 8) {
+          // SSE2 has only signed 16 bit min/max, values are biased by 0x8000
+          const __m128i bias = _mm_set1_epi16(short(0x8000));
+          const __m128i zero = _mm_setzero_si128();
+          __m128i vmin = _mm_set1_epi16(0x7FFF);
+          __m128i vmax = _mm_set1_epi16(short(0x8000));
+          while (i + 8 <= size) {
+            // 32 bit lanes get two values per step, flushed before they can overflow
+            size_t end = i + std::min((size - i) / 8, size_t(0x8000)) * 8;
+            __m128i acc = zero;
+            for (; i < end; i += 8) {
+              __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+              __m128i b = _mm_xor_si128(v, bias);
+              vmin = _mm_min_epi16(vmin, b);
+              vmax = _mm_max_epi16(vmax, b);
+              acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero)));
+            }
+            sum += horizontalSum32(acc);
+          }
+          uint16_t mins[8];
+          uint16_t maxs[8];
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(mins), _mm_xor_si128(vmin, bias));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(maxs), _mm_xor_si128(vmax, bias));
+          for (int k = 0; k < 8; k++) {
+            lo = std::min(lo, mins[k]);
+            hi = std::max(hi, maxs[k]);
+          }
+        }
+#endif
+        for (; i < size; i++) {
+          lo = std::min(lo, data[i]);
+          hi = std::max(hi, data[i]);
+          sum += data[i];
+        }
+        return makeSummary(lo, hi, sum, size);
+      }
+
+      // number of values greater than threshold
+      static size_t countAbove(const uint8_t *data, size_t size, uint8_t threshold) {
+        size_t count = 0;
+        size_t i = 0;
+#ifdef LGMC_SSE2
+        const __m128i bias = _mm_set1_epi8(char(0x80));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i thr = _mm_xor_si128(_mm_set1_epi8(char(threshold)), bias);
+        while (i + 16 <= size) {
+          // 8 bit lane counters are flushed every 255 steps
+          size_t end = i + std::min((size - i) / 16, size_t(0xFF)) * 16;
+          __m128i acc = zero;
+          for (; i < end; i += 16) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), bias);
+            // matching lanes are -1
+            acc = _mm_sub_epi8(acc, _mm_cmpgt_epi8(v, thr));
+          }
+          acc = _mm_sad_epu8(acc, zero);
+          count += size_t(_mm_cvtsi128_si32(acc)) + size_t(_mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc)));
+        }
+#endif
+        for (; i < size; i++) {
+          count += data[i] > threshold;
+        }
+        return count;
+      }
+
+      static size_t countAbove(const uint16_t *data, size_t size, uint16_t threshold) {
+        size_t count = 0;
+        size_t i = 0;
+#ifdef LGMC_SSE2
+        const __m128i bias = _mm_set1_epi16(short(0x8000));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i thr = _mm_xor_si128(_mm_set1_epi16(short(threshold)), bias);
+        while (i + 8 <= size) {
+          size_t end = i + std::min((size - i) / 8, size_t(0xFFFF)) * 8;
+          __m128i acc = zero;
+          for (; i < end; i += 8) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), bias);
+            acc = _mm_sub_epi16(acc, _mm_cmpgt_epi16(v, thr));
+          }
+          count += horizontalSum32(_mm_add_epi32(_mm_unpacklo_epi16(acc, zero), _mm_unpackhi_epi16(acc, zero)));
+        }
+#endif
+        for (; i < size; i++) {
+          count += data[i] > threshold;
+        }
+        return count;
+      }
+
+      // number of values less than threshold
+      template <typename T>
+      static size_t countBelow(const T *data, size_t size, T threshold) {
+        return threshold == 0 ? 0 : size - countAbove(data, size, T(threshold - 1));
+      }
+
+      // indexes of values greater than threshold are appended to rows
+      template <typename T>
+      static void selectAbove(const T *data, size_t size, T threshold, std::vector<uint32_t> &rows) {
+        for (size_t i = 0; i < size; i++) {
+          if (data[i] > threshold) {
+            rows.push_back(uint32_t(i));
+          }
+        }
+      }
+
+    private:
+      static ColumnSummary makeSummary(uint32_t lo, uint32_t hi, uint64_t sum, size_t size) {
+        ColumnSummary s;
+        s.min = size ? lo : 0;
+        s.max = size ? hi : 0;
+        s.mean = size ? double(sum) / size : 0;
+        s.count = size;
+        return s;
+      }
+
+#ifdef LGMC_SSE2
+      static uint64_t horizontalSum32(__m128i v) {
+        uint32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), v);
+        return uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+      }
+#endif
+  };
+
+  /* columnar store of long test reports
+   * every field of Long_Test_Report is kept in its own contiguous array,
+   * so fleet-wide scans read only the columns they need
+   */
+  class LongReportStore {
+    public:
+      // 16 bit columns
+      enum Field16 {
+        START_DATE,
+        START_TIME,
+        START_BOTTOM_CELL_VOLTS,
+        TEST_DURATION_ACHIEVED,
+        END_BOTTOM_CELL_VOLTS,
+        END_TOP_CELL_VOLTS,
+        BOT_CELL_AMP_HOURS,
+        TOP_CELL_AMP_HOURS,
+        BOT_CELL_WATT_HOURS,
+        TOP_CELL_WATT_HOURS,
+        FIELD16_COUNT,
+      };
+
+      // 8 bit columns, raw encoded values
+      enum Field8 {
+        TEST_DURATION,
+        START_CELL_MODE,
+        START_LOAD_VOLTS,
+        START_LOAD_CURRENT,
+        TEST_DURATION_ACHIEVED_WITH_BOTH_CELLS,
+        END_LOAD_VOLTS,
+        END_LOAD_CURRENT,
+        EXPONENTS,
+        TEST_FLAGS,
+        FIELD8_COUNT,
+      };
+
+      void reserve(size_t reports) {
+        m_nodes.reserve(reports);
+        for (auto &c : m_columns16) {
+          c.reserve(reports);
+        }
+        for (auto &c : m_columns8) {
+          c.reserve(reports);
+        }
+      }
+
+      void append(NodeAddr node, const Long_Test_Report &r) {
+        m_nodes.push_back(node);
+        m_columns16[START_DATE].push_back(r.start_date.data.data);
+        m_columns16[START_TIME].push_back(r.start_time.data.data);
+        m_columns16[START_BOTTOM_CELL_VOLTS].push_back(r.start_bottom_cell_volts.data);
+        m_columns16[TEST_DURATION_ACHIEVED].push_back(r.test_duration_achieved.data);
+        m_columns16[END_BOTTOM_CELL_VOLTS].push_back(r.end_bottom_cell_volts.data);
+        m_columns16[END_TOP_CELL_VOLTS].push_back(r.end_top_cell_volts.data);
+        m_columns16[BOT_CELL_AMP_HOURS].push_back(r.bot_cell_amp_hours.data);
+        m_columns16[TOP_CELL_AMP_HOURS].push_back(r.top_cell_amp_hours.data);
+        m_columns16[BOT_CELL_WATT_HOURS].push_back(r.bot_cell_watt_hours.data);
+        m_columns16[TOP_CELL_WATT_HOURS].push_back(r.top_cell_watt_hours.data);
+
+        m_columns8[TEST_DURATION].push_back(r.test_duration.data);
+        m_columns8[START_CELL_MODE].push_back(r.start_cell_mode.data);
+        m_columns8[START_LOAD_VOLTS].push_back(r.start_load_volts.data);
+        m_columns8[START_LOAD_CURRENT].push_back(r.start_load_current.data);
+        m_columns8[TEST_DURATION_ACHIEVED_WITH_BOTH_CELLS].push_back(r.test_duration_achieved_with_both_cells.data);
+        m_columns8[END_LOAD_VOLTS].push_back(r.end_load_volts.data);
+        m_columns8[END_LOAD_CURRENT].push_back(r.end_load_current.data);
+        m_columns8[EXPONENTS].push_back(r.exponents.data);
+        m_columns8[TEST_FLAGS].push_back(r.test_flags.data);
+      }
+
+      // invalid report (index 0xFF) is skipped, returns false for it
+      bool append(NodeAddr node, const GetReportLongCmd::data_t_long &r) {
+        if (r.index.data == 0xFF) {
+          return false;
+        }
+        append(node, r.rep);
+        return true;
+      }
+
+      void clear() {
+        m_nodes.clear();
+        for (auto &c : m_columns16) {
+          c.clear();
+        }
+        for (auto &c : m_columns8) {
+          c.clear();
+        }
+      }
+
+      size_t size() const {
+        return m_nodes.size();
+      }
+
+      const std::vector<NodeAddr> & nodes() const {
+        return m_nodes;
+      }
+
+      const std::vector<uint16_t> & column(Field16 f) const {
+        return m_columns16[f];
+      }
+
+      const std::vector<uint8_t> & column(Field8 f) const {
+        return m_columns8[f];
+      }
+
+      ColumnSummary summary(Field16 f) const {
+        return ColumnScan::summary(m_columns16[f].data(), size());
+      }
+
+      ColumnSummary summary(Field8 f) const {
+        return ColumnScan::summary(m_columns8[f].data(), size());
+      }
+
+      size_t countAbove(Field16 f, uint16_t threshold) const {
+        return ColumnScan::countAbove(m_columns16[f].data(), size(), threshold);
+      }
+
+      size_t countAbove(Field8 f, uint8_t threshold) const {
+        return ColumnScan::countAbove(m_columns8[f].data(), size(), threshold);
+      }
+
+      size_t countBelow(Field16 f, uint16_t threshold) const {
+        return ColumnScan::countBelow(m_columns16[f].data(), size(), threshold);
+      }
+
+      size_t countBelow(Field8 f, uint8_t threshold) const {
+        return ColumnScan::countBelow(m_columns8[f].data(), size(), threshold);
+      }
+
+      // rows with value greater than threshold
+      std::vector<uint32_t> selectAbove(Field16 f, uint16_t threshold) const {
+        std::vector<uint32_t> rows;
+        ColumnScan::selectAbove(m_columns16[f].data(), size(), threshold, rows);
+        return rows;
+      }
+
+      // start time of every report in seconds since epoch, decoded from the date and time columns
+      std::vector<int64_t> startSeconds(const TimeZone & tz = TimeZone::local(), uint8_t century = 20) const {
+        std::vector<int64_t> seconds(size());
+        CompressedDateTime::toSeconds(m_columns16[START_DATE].data(), m_columns16[START_TIME].data(), size(), seconds.data(), tz, century);
+        return seconds;
+      }
+
+    private:
+      std::vector<NodeAddr> m_nodes;
+      std::array<std::vector<uint16_t>, FIELD16_COUNT> m_columns16;
+      std::array<std::vector<uint8_t>, FIELD8_COUNT> m_columns8;
+  };
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <repM3.h>
+
+#include <unordered_map>
+
+namespace lgmc {
+
+  /* occurrences of Test_Schedule in device local time (seconds since epoch without zone)
+   * day matches when its month, day of month and day of week bits are all set,
+   * days_of_week bit 0 is Sunday, days_of_month bit 0 is the 1st, months bit 0 is January,
+   * two digit year matches when (year & year_mask) == (schedule year & year_mask), zero mask is every year
+   * candidate days of the month are computed as one 31 bit mask, no day by day iteration
+   */
+  class ScheduleEngine {
+    public:
+      enum : int {
+        // two digit year repeats after 100 years
+        max_years = 101,
+      };
+
+      // bit per matching day of the month, month is 0 - 11
+      static uint32_t dayMask(const Test_Schedule &s, int year, unsigned month) {
+        static const uint8_t month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        const unsigned days = month_days[month] + (month == 1 && CivilTime::isLeap(year) ? 1 : 0);
+        const unsigned first = CivilTime::weekdayFromDays(CivilTime::daysFromCivil(year, month + 1, 1));
+        // week pattern repeated 6 times, bit d + first is the weekday of day d
+        const uint64_t weeks = uint64_t(s.days_of_week.data & 0x7F) * 0x40810204081ull;
+        return uint32_t(weeks >> first) & s.days_of_month.data & ((uint32_t(1) << days) - 1);
+      }
+
+      static bool yearMatches(const Test_Schedule &s, int year) {
+        return ((year % 100) & s.year_mask.data) == (s.year.data & s.year_mask.data);
+      }
+
+      // start of the test in seconds of the day
+      static int32_t startSeconds(const Test_Schedule &s) {
+        return s.start_time.hr.data * 3600 + s.start_time.min.data * 60 + s.start_time.sec.data;
+      }
+
+      // first occurrence at or after local time, false when the schedule never matches
+      static bool next(const Test_Schedule &s, int64_t local_seconds, int64_t &occurrence) {
+        const int64_t days = CivilTime::daysFromSeconds(local_seconds);
+        const int32_t start = startSeconds(s);
+        CivilDate date = CivilTime::civilFromDays(days);
+        int year = date.year;
+        unsigned month = date.month - 1;
+        // today only when the start time didn't pass
+        unsigned from_day = date.day - 1 + (local_seconds - days * CivilTime::seconds_per_day > start ? 1 : 0);
+
+        const int last_year = year + max_years;
+        while (year <= last_year) {
+          if (!yearMatches(s, year)) {
+            year++;
+            month = 0;
+            from_day = 0;
+            continue;
+          }
+          if ((s.months.data >> month) & 1) {
+            // from_day is at most 31, later days are kept
+            const uint32_t mask = dayMask(s, year, month) & ~((uint32_t(1) << from_day) - 1);
+            if (mask != 0) {
+              occurrence = CivilTime::daysFromCivil(year, month + 1, 1 + lowestBit(mask)) * CivilTime::seconds_per_day + start;
+              return true;
+            }
+          }
+          from_day = 0;
+          if (++month == 12) {
+            month = 0;
+            year++;
+          }
+        }
+        return false;
+      }
+
+      // up to n following occurrences, returns their number
+      static size_t next(const Test_Schedule &s, int64_t local_seconds, size_t n, int64_t *occurrences) {
+        size_t count = 0;
+        for (; count < n; count++) {
+          if (!next(s, local_seconds, occurrences[count])) {
+            break;
+          }
+          local_seconds = occurrences[count] + 1;
+        }
+        return count;
+      }
+
+      static std::vector<int64_t> next(const Test_Schedule &s, int64_t local_seconds, size_t n) {
+        std::vector<int64_t> occurrences(n);
+        occurrences.resize(next(s, local_seconds, n, occurrences.data()));
+        return occurrences;
+      }
+
+    private:
+      static unsigned lowestBit(uint32_t w) {
+#if defined(__GNUC__) || defined(__clang__)
+        return unsigned(__builtin_ctz(w));
+#else
+        unsigned n = 0;
+        for (; (w & 1) == 0; w >>= 1) {
+          n++;
+        }
+        return n;
+#endif
+      }
+  };
+
+  /* spreads test start times of the fleet over time window so nodes don't finish tests
+   * and raise report flags in the same minute, days of the base schedule are kept
+   */
+  class StaggerPlanner {
+    public:
+      struct Config {
+        Config()
+        : window_start(120), window(240), slot(1) {}
+
+        // minutes after midnight
+        unsigned window_start;
+        // length of the window in minutes
+        unsigned window;
+        // minutes between starts of consecutive slots
+        unsigned slot;
+      };
+
+      struct Assignment {
+        NodeAddr node;
+        Test_Schedule schedule;
+      };
+
+      // number of start slots in the window
+      static size_t slots(const Config &config) {
+        return std::max<size_t>(1, config.window / std::max(1u, config.slot));
+      }
+
+      /* node i of the list starts in slot i % slots, neighbouring addresses are in different slots
+       * minute of the day wraps around midnight
+       */
+      static std::vector<Assignment> plan(const Test_Schedule &base, const std::vector<NodeAddr> &nodes, const Config &config = Config()) {
+        const size_t n = slots(config);
+        std::vector<Assignment> result(nodes.size());
+        for (size_t i = 0; i < nodes.size(); i++) {
+          Assignment &a = result[i];
+          a.node = nodes[i];
+          a.schedule = base;
+          unsigned minute = unsigned((config.window_start + (i % n) * std::max(1u, config.slot)) % (24 * 60));
+          a.schedule.start_time.hr = minute / 60;
+          a.schedule.start_time.min = minute % 60;
+          a.schedule.start_time.sec = 0;
+        }
+        return result;
+      }
+
+      // highest number of tests starting in the same minute in local time range from - to
+      static size_t peak(const std::vector<Assignment> &plan, int64_t from, int64_t to) {
+        std::unordered_map<int64_t, size_t> minutes;
+        size_t peak = 0;
+        for (const Assignment &a : plan) {
+          int64_t t = from;
+          int64_t occurrence;
+          while (ScheduleEngine::next(a.schedule, t, occurrence) && occurrence < to) {
+            peak = std::max(peak, ++minutes[occurrence / 60]);
+            t = occurrence + 1;
+          }
+        }
+        return peak;
+      }
+  };
+}
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <repM3_transport.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <unordered_map>
+
+namespace lgmc {
+
+  /* pushes desired settings pages to many nodes
+   * page with unknown actual content is read first, SetSettings is sent only for pages which differ,
+   * every node has at most one outstanding request, up to window requests are outstanding in total
+   */
+  class SettingsSync : public Transport::Receiver {
+    public:
+      struct Config {
+        Config()
+        : window(32), timeout(2000), retries(2) {}
+
+        size_t window;
+        std::chrono::milliseconds timeout;
+        // number of repeated requests after timeout
+        int retries;
+      };
+
+      struct Stats {
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        // pages which already had desired content
+        uint64_t unchanged = 0;
+        uint64_t written = 0;
+        uint64_t timeouts = 0;
+        // pages not read or written after all retries or refused by the node
+        uint64_t failed = 0;
+        // responses not matching outstanding request
+        uint64_t unexpected = 0;
+      };
+
+      // page of the node with different actual and desired content
+      struct Write {
+        NodeAddr node;
+        uint8_t page;
+      };
+
+      SettingsSync(Transport &transport, const Config &config = Config())
+      : m_transport(transport), m_config(config) {
+        m_config.window = std::max<size_t>(1, m_config.window);
+      }
+
+      // desired content of the page for all nodes
+      void setDesired(uint8_t page, const System_Settings_page0 &settings) {
+        copy(m_desired[page], settings);
+      }
+
+      // desired content of the page of one node overriding the fleet one, page without fleet content is synchronised only on this node
+      void setDesired(NodeAddr node, uint8_t page, const System_Settings_page0 &settings) {
+        copy(m_node_desired[key(node, page)], settings);
+      }
+
+      // known actual content, e.g. from earlier GetSettings responses, the page isn't read again
+      void setActual(NodeAddr node, uint8_t page, const System_Settings_page0 &settings) {
+        copy(m_actual[key(node, page)], settings);
+      }
+
+      bool actual(NodeAddr node, uint8_t page, System_Settings_page0 &settings) const {
+        auto it = m_actual.find(key(node, page));
+        if (it == m_actual.end()) {
+          return false;
+        }
+        copy(settings, it->second);
+        return true;
+      }
+
+      // every page with fleet or node desired content is synchronised on the node
+      void addNode(NodeAddr node) {
+        if (m_index.count(node)) {
+          return;
+        }
+        m_index[node] = m_nodes.size();
+        NodeState s;
+        s.node = node;
+        m_nodes.push_back(s);
+      }
+
+      // pages known to differ and pages with unknown actual content, nothing is sent
+      std::vector<Write> plan() const {
+        std::vector<Write> result;
+        std::vector<uint8_t> desired_pages;
+        for (const NodeState &s : m_nodes) {
+          pages(s.node, desired_pages);
+          for (uint8_t page : desired_pages) {
+            if (!isSynced(s.node, page)) {
+              result.push_back(Write{s.node, page});
+            }
+          }
+        }
+        return result;
+      }
+
+      /* one step: queue requests up to the window, receive responses and handle timeouts
+       * returns false when all nodes are finished
+       */
+      bool step(std::chrono::microseconds wait = std::chrono::microseconds(1000)) {
+        if (!m_started) {
+          start();
+        }
+        expire(clock::now());
+        while (m_in_flight < m_config.window && !m_ready.empty()) {
+          if (!next(m_ready.front(), clock::now())) {
+            break;
+          }
+          m_ready.pop_front();
+        }
+        bool active = m_in_flight > 0 || !m_ready.empty();
+        if (active) {
+          auto timeout = m_deadlines.empty() ? wait
+            : std::min(wait, std::chrono::duration_cast<std::chrono::microseconds>(m_deadlines.front().deadline - clock::now()));
+          m_transport.receive(*this, std::max(std::chrono::microseconds(0), timeout));
+        }
+        return active;
+      }
+
+      const Stats & run() {
+        while (step()) {
+        }
+        return m_stats;
+      }
+
+      const Stats & stats() const {
+        return m_stats;
+      }
+
+      void onFrame(NodeAddr node, const uint8_t *data, size_t size) override {
+        auto it = m_index.find(node);
+        FrameView frame(data, size);
+        if (it == m_index.end() || !m_nodes[it->second].in_flight) {
+          m_stats.unexpected++;
+          return;
+        }
+        NodeState &s = m_nodes[it->second];
+
+        if (s.writing) {
+          const SetSettingsPageCmd::data_t *r = SetSettingsPageCmd::impl_type::payload(frame);
+          if (r == nullptr) {
+            m_stats.unexpected++;
+            return;
+          }
+          finish(s, it->second);
+          if (r->status.data == status_ok) {
+            copy(m_actual[key(node, s.page)], desired(node, s.page));
+            m_stats.written++;
+          } else {
+            m_stats.failed++;
+          }
+          return;
+        }
+
+        const GetSettingsCmd::data_t *r = GetSettingsCmd::impl_type::payload(frame);
+        if (r == nullptr || r->system_settings_page.data != s.page) {
+          m_stats.unexpected++;
+          return;
+        }
+        copy(m_actual[key(node, s.page)], r->page);
+        if (isSynced(node, s.page)) {
+          m_stats.unchanged++;
+        } else {
+          // write follows the read immediately
+          s.pages.push_back(s.page);
+        }
+        finish(s, it->second);
+      }
+
+    private:
+      typedef std::chrono::steady_clock clock;
+
+      enum : uint8_t {
+        status_ok = 170,
+      };
+
+      struct NodeState {
+        NodeAddr node;
+        // pages waiting for read or write, next one is the last
+        std::vector<uint8_t> pages;
+        uint8_t page = 0;
+        bool in_flight = false;
+        bool writing = false;
+        int retries = 0;
+        uint32_t seq = 0;
+      };
+
+      struct Deadline {
+        clock::time_point deadline;
+        size_t node;
+        uint32_t seq;
+      };
+
+      static uint32_t key(NodeAddr node, uint8_t page) {
+        return uint32_t(node) << 8 | page;
+      }
+
+      // UINT14 assignment takes non-const reference
+      static void copy(System_Settings_page0 &dst, const System_Settings_page0 &src) {
+        std::memcpy(static_cast<void *>(&dst), &src, sizeof(dst));
+      }
+
+      // fleet pages and pages desired only for the node, ascending
+      void pages(NodeAddr node, std::vector<uint8_t> &result) const {
+        result.clear();
+        for (const auto &d : m_desired) {
+          result.push_back(d.first);
+        }
+        // overrides of the node are consecutive keys
+        for (auto it = m_node_desired.lower_bound(key(node, 0)); it != m_node_desired.end() && it->first <= key(node, 0xFF); ++it) {
+          if (!m_desired.count(uint8_t(it->first))) {
+            result.push_back(uint8_t(it->first));
+          }
+        }
+        std::sort(result.begin(), result.end());
+      }
+
+      const System_Settings_page0 & desired(NodeAddr node, uint8_t page) const {
+        auto it = m_node_desired.find(key(node, page));
+        return it != m_node_desired.end() ? it->second : m_desired.at(page);
+      }
+
+      bool isSynced(NodeAddr node, uint8_t page) const {
+        auto it = m_actual.find(key(node, page));
+        return it != m_actual.end() && SettingsCodec::equal(it->second, desired(node, page));
+      }
+
+      // pages of every node, already synchronised pages are skipped without any request
+      void start() {
+        m_started = true;
+        std::vector<uint8_t> desired_pages;
+        for (size_t i = 0; i < m_nodes.size(); i++) {
+          NodeState &s = m_nodes[i];
+          pages(s.node, desired_pages);
+          for (auto page = desired_pages.rbegin(); page != desired_pages.rend(); ++page) {
+            if (isSynced(s.node, *page)) {
+              m_stats.unchanged++;
+            } else {
+              s.pages.push_back(*page);
+            }
+          }
+          if (!s.pages.empty()) {
+            m_ready.push_back(i);
+          }
+        }
+      }
+
+      // send request for the next page of the node, write when the actual content is known
+      bool next(size_t i, clock::time_point now) {
+        NodeState &s = m_nodes[i];
+        uint8_t page = s.pages.back();
+        bool write = m_actual.count(key(s.node, page)) != 0;
+        if (!send(s, page, write)) {
+          return false;
+        }
+        s.pages.pop_back();
+        s.page = page;
+        s.writing = write;
+        s.in_flight = true;
+        s.retries = 0;
+        s.seq++;
+        m_in_flight++;
+        m_deadlines.push_back(Deadline{now + m_config.timeout, i, s.seq});
+        return true;
+      }
+
+      bool send(const NodeState &s, uint8_t page, bool write) {
+        if (write) {
+          SetSettingsPageCmd::data_send_t d;
+          d.system_settings_page = page;
+          copy(d.page, desired(s.node, page));
+          SetSettingsPageCmd::impl_type::secure_frame_type frame = SetSettingsPageCmd::impl_type::encodeSecure(d);
+          if (!m_transport.send(s.node, frame.data(), frame.size())) {
+            return false;
+          }
+          m_stats.writes++;
+          return true;
+        }
+        GetSettingsCmd::data_send_t d;
+        d.system_settings_page = page;
+        GetSettingsCmd::impl_type::secure_frame_type frame = GetSettingsCmd::impl_type::encodeSecure(d);
+        if (!m_transport.send(s.node, frame.data(), frame.size())) {
+          return false;
+        }
+        m_stats.reads++;
+        return true;
+      }
+
+      void finish(NodeState &s, size_t i) {
+        s.in_flight = false;
+        m_in_flight--;
+        if (!s.pages.empty()) {
+          m_ready.push_back(i);
+        }
+      }
+
+      /* deadlines are ordered by send time as timeout is constant
+       * when the transport is busy the request stays outstanding and the next step repeats it without using a retry
+       */
+      void expire(clock::time_point now) {
+        while (!m_deadlines.empty()) {
+          Deadline &d = m_deadlines.front();
+          NodeState &s = m_nodes[d.node];
+          if (s.in_flight && s.seq == d.seq) {
+            if (d.deadline > now) {
+              break;
+            }
+            if (s.retries >= m_config.retries) {
+              m_stats.timeouts++;
+              m_stats.failed++;
+              finish(s, d.node);
+            } else if (send(s, s.page, s.writing)) {
+              m_stats.timeouts++;
+              s.retries++;
+              s.seq++;
+              m_deadlines.push_back(Deadline{now + m_config.timeout, d.node, s.seq});
+            } else {
+              break;
+            }
+          }
+          m_deadlines.pop_front();
+        }
+      }
+
+    private:
+      Transport &m_transport;
+      Config m_config;
+      std::map<uint8_t, System_Settings_page0> m_desired;
+      // ordered so overrides of one node are found by range
+      std::map<uint32_t, System_Settings_page0> m_node_desired;
+      std::unordered_map<uint32_t, System_Settings_page0> m_actual;
+      std::vector<NodeState> m_nodes;
+      std::unordered_map<NodeAddr, size_t> m_index;
+      std::deque<size_t> m_ready;
+      std::deque<Deadline> m_deadlines;
+      size_t m_in_flight = 0;
+      Stats m_stats;
+      bool m_started = false;
+  };
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <repM3_transport.h>
+
+#include <functional>
+#include <queue>
+#include <random>
+#include <thread>
+
+namespace lgmc {
+
+  /* in-process transport for tests and benchmarks
+   * each request is answered by the responder, response is delivered after configured latency
+   */
+  class SimTransport : public Transport {
+    public:
+      enum : size_t {
+        max_frame_size = 0xFF + 4,
+      };
+
+      /* writes response frame for the request to response buffer
+       * returns size of the response or 0 when node doesn't answer
+       */
+      typedef std::function<size_t(NodeAddr node, const uint8_t *request, size_t size, uint8_t *response, size_t capacity)> Responder;
+
+      struct Config {
+        Config()
+        : latency(0), jitter(0), max_in_flight(0), seed(1) {}
+
+        std::chrono::microseconds latency;
+        // uniformly distributed extra latency 0..jitter
+        std::chrono::microseconds jitter;
+        // send() fails when this number of requests is in flight, 0 means unlimited
+        size_t max_in_flight;
+        unsigned seed;
+      };
+
+      explicit SimTransport(Responder responder, const Config &config = Config())
+      : m_responder(responder), m_config(config), m_random(config.seed) {}
+
+      bool send(NodeAddr node, const uint8_t *data, size_t size) override {
+        if (m_config.max_in_flight != 0 && m_queue.size() >= m_config.max_in_flight) {
+          return false;
+        }
+        m_sent++;
+        Pending p;
+        p.size = m_responder(node, data, size, p.data, sizeof(p.data));
+        if (p.size == 0) {
+          return true;
+        }
+        p.node = node;
+        p.seq = m_seq++;
+        p.due = clock::now() + m_config.latency;
+        if (m_config.jitter.count() > 0) {
+          p.due += std::chrono::microseconds(m_random() % (m_config.jitter.count() + 1));
+        }
+        m_queue.push(p);
+        return true;
+      }
+
+      size_t receive(Receiver &receiver, std::chrono::microseconds timeout) override {
+        auto deadline = clock::now() + timeout;
+        if (!m_queue.empty() && m_queue.top().due > clock::now()) {
+          std::this_thread::sleep_until(std::min(deadline, m_queue.top().due));
+        }
+        size_t delivered = 0;
+        auto now = clock::now();
+        while (!m_queue.empty() && m_queue.top().due <= now) {
+          Pending p = m_queue.top();
+          m_queue.pop();
+          receiver.onFrame(p.node, p.data, p.size);
+          delivered++;
+        }
+        m_received += delivered;
+        return delivered;
+      }
+
+      // number of responses waiting for delivery
+      size_t inFlight() const {
+        return m_queue.size();
+      }
+
+      uint64_t sent() const {
+        return m_sent;
+      }
+
+      uint64_t received() const {
+        return m_received;
+      }
+
+    private:
+      typedef std::chrono::steady_clock clock;
+
+      struct Pending {
+        clock::time_point due;
+        uint64_t seq;
+        NodeAddr node;
+        size_t size;
+        uint8_t data[max_frame_size];
+
+        // earliest due first, same due in send order
+        bool operator<(const Pending &other) const {
+          return due != other.due ? due > other.due : seq > other.seq;
+        }
+      };
+
+    private:
+      Responder m_responder;
+      Config m_config;
+      std::mt19937 m_random;
+      std::priority_queue<Pending> m_queue;
+      uint64_t m_seq = 0;
+      uint64_t m_sent = 0;
+      uint64_t m_received = 0;
+  };
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <repM3.h>
+
+#include <unordered_map>
+
+namespace lgmc {
+
+  /* last response payload of every command per node
+   * poll is skipped while the entry is fresh (younger than TTL of the command),
+   * byte-identical response is reported as unchanged so the caller can skip decoding and encoding
+   */
+  class DeviceStateCache {
+    public:
+      typedef std::chrono::steady_clock clock;
+
+      enum Change {
+        NEW,
+        CHANGED,
+        UNCHANGED,
+        // response frame is not valid, cache is not changed
+        INVALID,
+      };
+
+      struct Stats {
+        uint64_t fresh = 0;
+        uint64_t stale = 0;
+        uint64_t changed = 0;
+        uint64_t unchanged = 0;
+      };
+
+      // all commands use default TTL until set
+      explicit DeviceStateCache(clock::duration default_ttl = std::chrono::seconds(60)) {
+        m_ttl.fill(default_ttl);
+      }
+
+      void setTtl(uint8_t command, clock::duration ttl) {
+        m_ttl[command] = ttl;
+      }
+
+      template <typename Cmd>
+      void setTtl(clock::duration ttl) {
+        setTtl(Cmd::impl_type::command_id, ttl);
+      }
+
+      clock::duration ttl(uint8_t command) const {
+        return m_ttl[command];
+      }
+
+      /* entry is younger than TTL of the command and doesn't need to be polled
+       * selector separates responses of one command with different request, e.g. settings page
+       */
+      bool isFresh(NodeAddr node, uint8_t command, uint8_t selector = 0, clock::time_point now = clock::now()) {
+        auto it = m_entries.find(key(node, command, selector));
+        bool fresh = it != m_entries.end() && now - it->second.checked < m_ttl[command];
+        (fresh ? m_stats.fresh : m_stats.stale)++;
+        return fresh;
+      }
+
+      template <typename Cmd>
+      bool isFresh(NodeAddr node, uint8_t selector = 0, clock::time_point now = clock::now()) {
+        return isFresh(node, Cmd::impl_type::command_id, selector, now);
+      }
+
+      // store payload of the response frame, command is the frame id
+      Change update(NodeAddr node, const FrameView &frame, uint8_t selector = 0, clock::time_point now = clock::now()) {
+        if (!frame.isValid()) {
+          return INVALID;
+        }
+        return update(node, frame.id(), frame.payload(), frame.payloadSize(), selector, now);
+      }
+
+      Change update(NodeAddr node, uint8_t command, const uint8_t *payload, size_t size, uint8_t selector = 0, clock::time_point now = clock::now()) {
+        // emplace() would allocate the node also for existing entry
+        const uint32_t k = key(node, command, selector);
+        auto it = m_entries.find(k);
+        const bool added = it == m_entries.end();
+        if (added) {
+          it = m_entries.emplace(k, Entry()).first;
+        }
+        Entry &e = it->second;
+        e.checked = now;
+        if (!added && e.data.size() == size && std::equal(payload, payload + size, e.data.begin())) {
+          m_stats.unchanged++;
+          return UNCHANGED;
+        }
+        e.data.assign(payload, payload + size);
+        e.changed = now;
+        m_stats.changed++;
+        return added ? NEW : CHANGED;
+      }
+
+      // cached payload of the command, false when missing or the size doesn't match the command
+      template <typename Cmd>
+      bool get(NodeAddr node, typename Cmd::impl_type::recv_type &data, uint8_t selector = 0) const {
+        const Entry *e = find(node, Cmd::impl_type::command_id, selector);
+        if (e == nullptr || e->data.size() != Cmd::impl_type::recv_payload_size) {
+          return false;
+        }
+        std::memcpy(static_cast<void *>(&data), e->data.data(), e->data.size());
+        return true;
+      }
+
+      // time of the last change of the payload, zero time point when missing
+      clock::time_point changed(NodeAddr node, uint8_t command, uint8_t selector = 0) const {
+        const Entry *e = find(node, command, selector);
+        return e == nullptr ? clock::time_point() : e->changed;
+      }
+
+      // next poll of the entry is needed
+      void invalidate(NodeAddr node, uint8_t command, uint8_t selector = 0) {
+        m_entries.erase(key(node, command, selector));
+      }
+
+      void invalidate(NodeAddr node) {
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+          if (it->first >> 16 == node) {
+            it = m_entries.erase(it);
+          } else {
+            ++it;
+          }
+        }
+      }
+
+      size_t size() const {
+        return m_entries.size();
+      }
+
+      const Stats & stats() const {
+        return m_stats;
+      }
+
+    private:
+      struct Entry {
+        clock::time_point checked;
+        clock::time_point changed;
+        std::vector<uint8_t> data;
+      };
+
+      static uint32_t key(NodeAddr node, uint8_t command, uint8_t selector) {
+        return uint32_t(node) << 16 | uint32_t(command) << 8 | selector;
+      }
+
+      const Entry * find(NodeAddr node, uint8_t command, uint8_t selector) const {
+        auto it = m_entries.find(key(node, command, selector));
+        return it == m_entries.end() ? nullptr : &it->second;
+      }
+
+    private:
+      std::array<clock::duration, 256> m_ttl;
+      std::unordered_map<uint32_t, Entry> m_entries;
+      Stats m_stats;
+  };
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <repM3.h>
+
+namespace lgmc {
+
+  /* resumable framer for a byte stream with 0xB1 ... 0xB2 frames
+   * chunks of arbitrary size are stored to the ring buffer, frames are validated by FrameView
+   * bytes are looked at once, only bytes of a rejected frame candidate are scanned again when resynchronising
+   */
+  class FrameStreamParser {
+    public:
+      enum : size_t {
+        // start, len (max 0xFF), crc and stop
+        max_frame_size = 0xFF + 4,
+      };
+
+      // capacity is rounded up to power of two, at least two maximal frames
+      explicit FrameStreamParser(size_t capacity = 4096) {
+        size_t cap = 1;
+        while (cap < capacity || cap < 2 * max_frame_size) {
+          cap <<= 1;
+        }
+        m_buffer.resize(cap);
+        m_mask = cap - 1;
+        reset();
+      }
+
+      // drop buffered data and statistics
+      void reset() {
+        m_head = 0;
+        m_tail = 0;
+        m_scan = 0;
+        m_frame_size = 0;
+        m_stats.reset();
+        m_dropped = 0;
+      }
+
+      /* store chunk to the ring buffer
+       * returns number of accepted bytes, it is less than size when the buffer is full
+       * previously returned frame is not valid after this call
+       */
+      size_t feed(const uint8_t *data, size_t size) {
+        size_t n = std::min(size, free());
+        size_t pos = index(m_head);
+        size_t first = std::min(n, m_buffer.size() - pos);
+        std::memcpy(&m_buffer[pos], data, first);
+        std::memcpy(&m_buffer[0], data + first, n - first);
+        m_head += n;
+        return n;
+      }
+
+      /* get next complete and valid frame from the buffered data
+       * returns false when more data are needed
+       */
+      bool next(FrameView &frame) {
+        while (true) {
+          if (m_frame_size == 0) {
+            // looking for start byte and length
+            if (!findStart()) {
+              return false;
+            }
+            if (m_head - m_tail < 2) {
+              return false;
+            }
+            size_t len = m_buffer[index(m_tail + 1)];
+            if (len == 0) {
+              // id is always present
+              reject(FRAME_BAD_LENGTH);
+              continue;
+            }
+            m_frame_size = len + 4;
+          }
+
+          if (m_head - m_tail < m_frame_size) {
+            return false;
+          }
+
+          frame = FrameView(linearize(), m_frame_size);
+          if (!frame.isValid()) {
+            reject(frame.status());
+            continue;
+          }
+
+          m_tail += m_frame_size;
+          m_scan = m_tail;
+          m_frame_size = 0;
+          m_stats.add(FRAME_OK);
+          return true;
+        }
+      }
+
+      /* feed all data and call handler(const FrameView &) for every complete frame
+       * returns number of found frames
+       */
+      template <typename Handler>
+      size_t parse(const uint8_t *data, size_t size, Handler handler) {
+        size_t found = 0;
+        size_t done = 0;
+        FrameView frame;
+        while (true) {
+          while (next(frame)) {
+            handler(frame);
+            found++;
+          }
+          if (done == size) {
+            break;
+          }
+          done += feed(data + done, size - done);
+        }
+        return found;
+      }
+
+      // number of buffered bytes not processed yet
+      size_t available() const {
+        return size_t(m_head - m_tail);
+      }
+
+      size_t capacity() const {
+        return m_buffer.size();
+      }
+
+      // number of valid frames
+      uint64_t frames() const {
+        return m_stats.count(FRAME_OK);
+      }
+
+      // number of rejected frame candidates (bad crc, length or stop byte)
+      uint64_t rejected() const {
+        return m_stats.errors();
+      }
+
+      // valid frames and rejected candidates by reason
+      const FrameStats & stats() const {
+        return m_stats;
+      }
+
+      // number of bytes skipped while looking for start byte
+      uint64_t dropped() const {
+        return m_dropped;
+      }
+
+    private:
+      size_t index(uint64_t pos) const {
+        return size_t(pos) & m_mask;
+      }
+
+      size_t free() const {
+        return m_buffer.size() - available();
+      }
+
+      // skip bytes up to start byte, scanned bytes are not searched again
+      bool findStart() {
+        while (m_scan < m_head) {
+          size_t pos = index(m_scan);
+          size_t len = std::min(size_t(m_head - m_scan), m_buffer.size() - pos);
+          const uint8_t *begin = &m_buffer[pos];
+          const uint8_t *found = static_cast<const uint8_t *>(std::memchr(begin, FrameCodec::start_byte, len));
+          if (found != nullptr) {
+            m_scan += found - begin;
+            m_dropped += m_scan - m_tail;
+            m_tail = m_scan;
+            return true;
+          }
+          m_scan += len;
+        }
+        m_dropped += m_scan - m_tail;
+        m_tail = m_scan;
+        return false;
+      }
+
+      // frame candidate at tail as contiguous memory, copied only when it wraps around the ring end
+      const uint8_t * linearize() {
+        size_t pos = index(m_tail);
+        if (pos + m_frame_size <= m_buffer.size()) {
+          return &m_buffer[pos];
+        }
+        size_t first = m_buffer.size() - pos;
+        std::memcpy(m_frame, &m_buffer[pos], first);
+        std::memcpy(m_frame + first, &m_buffer[0], m_frame_size - first);
+        return m_frame;
+      }
+
+      // candidate is not a frame, resynchronise from the byte following its start byte
+      void reject(FrameStatus status) {
+        m_stats.add(status);
+        m_tail++;
+        m_scan = m_tail;
+        m_frame_size = 0;
+      }
+
+    private:
+      std::vector<uint8_t> m_buffer;
+      size_t m_mask;
+      // absolute stream positions, buffer index is position & mask
+      uint64_t m_head;
+      uint64_t m_tail;
+      uint64_t m_scan;
+      // size of the frame candidate at tail, 0 when looking for start byte
+      size_t m_frame_size;
+      uint8_t m_frame[max_frame_size];
+
+      FrameStats m_stats;
+      uint64_t m_dropped;
+  };
+}
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <repM3_broadcast.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace lgmc {
+
+  /* two-phase time synchronisation of the fleet
+   * one PresetTimeAndDate frame with the commit time is broadcast to all nodes, at the commit time
+   * one ChangeRtcToPreset (or TimeSync) broadcast switches all clocks together,
+   * GetTimeAndDate of a sample of nodes measures clock offsets, nodes off by more than tolerance
+   * and nodes without acknowledgement are synchronised again,
+   * nodes with bad_time_sync flag are preset first and always read back
+   */
+  class FleetTimeSync {
+    public:
+      enum Commit {
+        CHANGE_RTC_TO_PRESET,
+        TIME_SYNC,
+      };
+
+      struct Config {
+        Config()
+        : tz(TimeZone::local()), lead(1000), sample(32), tolerance(2), timeout(500), retries(3),
+          resync_rounds(2), commit(CHANGE_RTC_TO_PRESET) {}
+
+        // zone of device clocks
+        TimeZone tz;
+        /* commit time is at least lead after start of the preset phase, rounded up to whole second
+         * grows to 1.5 times the duration of a preset phase which ended too late
+         */
+        std::chrono::milliseconds lead;
+        // nodes read back after the first round, bad_time_sync nodes are read in addition
+        size_t sample;
+        // accepted offset of the device clock
+        std::chrono::seconds tolerance;
+        // broadcasts and reads
+        std::chrono::milliseconds timeout;
+        int retries;
+        // rounds for nodes which are not synchronised after the first one
+        int resync_rounds;
+        Commit commit;
+      };
+
+      struct Stats {
+        uint64_t rounds = 0;
+        uint64_t presets = 0;
+        uint64_t commits = 0;
+        uint64_t reads = 0;
+        // preset phases ended after the commit time, nodes were preset again with later time
+        uint64_t late = 0;
+        // read back clocks off by more than tolerance
+        uint64_t drifting = 0;
+        // nodes not acknowledging preset or commit
+        uint64_t failed = 0;
+      };
+
+      struct Measurement {
+        NodeAddr node;
+        // device clock minus gateway clock
+        std::chrono::seconds offset;
+        // time since the last commit to the node, zero when it was not synchronised
+        std::chrono::seconds since_sync;
+
+        // clock drift in parts per million, meaningful for measurements long after sync
+        double ppm() const {
+          return since_sync.count() > 0 ? offset.count() * 1e6 / since_sync.count() : 0;
+        }
+      };
+
+      FleetTimeSync(Transport &transport, const Config &config = Config())
+      : m_transport(transport), m_config(config), m_lead(config.lead) {
+        m_broadcast_config.timeout = config.timeout;
+        m_broadcast_config.retries = config.retries;
+      }
+
+      void addNode(NodeAddr node) {
+        if (m_known.insert(node).second) {
+          m_nodes.push_back(node);
+        }
+      }
+
+      void addNodes(const std::vector<NodeAddr> &nodes) {
+        for (NodeAddr node : nodes) {
+          addNode(node);
+        }
+      }
+
+      // nodes with bad_time_sync flag set in the last GetFlags responses
+      void setFlags(const FlagIndex &flags) {
+        m_priority.clear();
+        for (NodeAddr node : m_nodes) {
+          if (flags.has(node, FlagIndex::BAD_TIME_SYNC)) {
+            m_priority.insert(node);
+          }
+        }
+      }
+
+      void setBadTimeSync(NodeAddr node) {
+        m_priority.insert(node);
+      }
+
+      /* synchronise all nodes, the first round reads back the sample, resync rounds read back all their nodes
+       * returns false when some nodes are not synchronised, see resync()
+       */
+      bool run() {
+        std::vector<NodeAddr> nodes(m_nodes);
+        for (int round = 0; round <= m_config.resync_rounds && !nodes.empty(); round++) {
+          std::vector<NodeAddr> failed = sync(nodes);
+          std::vector<NodeAddr> drifting = check(round == 0 ? sample(nodes) : nodes);
+          nodes.clear();
+          std::set_union(failed.begin(), failed.end(), drifting.begin(), drifting.end(), std::back_inserter(nodes));
+        }
+        m_resync = nodes;
+        return m_resync.empty();
+      }
+
+      /* read clocks of the nodes, returns nodes off by more than tolerance
+       * nodes without response are not included
+       */
+      std::vector<NodeAddr> check(const std::vector<NodeAddr> &nodes) {
+        std::vector<NodeAddr> drifting;
+        Broadcast read(m_transport, m_broadcast_config);
+        read.addNodes(nodes);
+        read.setAcceptor([this, &drifting](NodeAddr node, const FrameView &frame) {
+          const GetTimeAndDateCmd::data_recv_t *t = GetTimeAndDateCmd::impl_type::payload(frame);
+          if (t == nullptr) {
+            return false;
+          }
+          Measurement &m = measurement(node, clock::now(), *t);
+          if (std::abs(m.offset.count()) > m_config.tolerance.count()) {
+            drifting.push_back(node);
+            m_stats.drifting++;
+          } else {
+            // bad_time_sync nodes stay first until their clock is read back correct
+            m_priority.erase(node);
+          }
+          return true;
+        });
+        read.setCommand<GetTimeAndDateCmd>();
+        read.run();
+        m_stats.reads += read.stats().acks;
+        std::sort(drifting.begin(), drifting.end());
+        return drifting;
+      }
+
+      // nodes not synchronised by the last run()
+      const std::vector<NodeAddr> & resync() const {
+        return m_resync;
+      }
+
+      // last measurement of the node
+      bool measurement(NodeAddr node, Measurement &m) const {
+        auto it = m_measurements.find(node);
+        if (it == m_measurements.end()) {
+          return false;
+        }
+        m = it->second;
+        return true;
+      }
+
+      const Stats & stats() const {
+        return m_stats;
+      }
+
+    private:
+      typedef std::chrono::system_clock clock;
+
+      enum : uint8_t {
+        status_ok = 170,
+      };
+
+      enum : int {
+        // preset phases of one round ending after their commit time
+        max_presets = 3,
+      };
+
+      // device clock has resolution of one second
+      static clock::time_point commitTime(clock::time_point earliest) {
+        auto t = std::chrono::time_point_cast<std::chrono::seconds>(earliest);
+        return t < earliest ? t + std::chrono::seconds(1) : t;
+      }
+
+      // same frame with the commit time to all nodes, nodes with bad time first
+      void presetNodes(Broadcast &preset, const std::vector<NodeAddr> &nodes, clock::time_point commit_time) {
+        preset.setCommand<PresetTimeAndDateCmd>(DateTimeBase::convertFromTimePoint(commit_time, m_config.tz));
+        preset.setAcceptor([](NodeAddr, const FrameView &frame) {
+          const PresetTimeAndDateCmd::data_t *d = PresetTimeAndDateCmd::impl_type::payload(frame);
+          return d != nullptr && d->status.data == status_ok;
+        });
+        for (NodeAddr node : nodes) {
+          if (m_priority.count(node)) {
+            preset.addNode(node);
+          }
+        }
+        preset.run();
+        preset.addNodes(nodes);
+        preset.run();
+        m_stats.presets += preset.stats().acks;
+      }
+
+      // preset and commit, returns sorted nodes without acknowledgement of any phase
+      std::vector<NodeAddr> sync(const std::vector<NodeAddr> &nodes) {
+        m_stats.rounds++;
+        std::unique_ptr<Broadcast> preset;
+        clock::time_point commit_time;
+        for (int attempt = 1; ; attempt++) {
+          const clock::time_point start = clock::now();
+          commit_time = commitTime(start + m_lead);
+          preset.reset(new Broadcast(m_transport, m_broadcast_config));
+          presetNodes(*preset, nodes, commit_time);
+          if (clock::now() <= commit_time) {
+            break;
+          }
+          // commit would switch clocks to a time in the past, lead has to cover the preset phase
+          m_stats.late++;
+          m_lead = std::max(m_lead, std::chrono::duration_cast<std::chrono::milliseconds>((clock::now() - start) * 3 / 2));
+          if (attempt == max_presets) {
+            std::vector<NodeAddr> failed(nodes);
+            std::sort(failed.begin(), failed.end());
+            m_stats.failed += failed.size();
+            return failed;
+          }
+        }
+        std::this_thread::sleep_until(commit_time);
+
+        Broadcast commit(m_transport, m_broadcast_config);
+        for (NodeAddr node : nodes) {
+          if (preset->acked(node)) {
+            commit.addNode(node);
+          }
+        }
+        if (m_config.commit == CHANGE_RTC_TO_PRESET) {
+          commit.setCommand<ChangeRtcToPresetCmd>();
+          commit.setAcceptor([](NodeAddr, const FrameView &frame) {
+            const ChangeRtcToPresetCmd::data_t *d = ChangeRtcToPresetCmd::impl_type::payload(frame);
+            return d != nullptr && d->result.data == 1;
+          });
+        } else {
+          commit.setCommand<TimeSyncCmd>();
+        }
+        commit.run();
+        m_stats.commits += commit.stats().acks;
+
+        std::vector<NodeAddr> failed;
+        for (NodeAddr node : nodes) {
+          if (commit.acked(node)) {
+            m_synced[node] = commit_time;
+          } else {
+            failed.push_back(node);
+          }
+        }
+        m_stats.failed += failed.size();
+        std::sort(failed.begin(), failed.end());
+        return failed;
+      }
+
+      // bad_time_sync nodes and every k-th other node so the sample covers the whole address range
+      std::vector<NodeAddr> sample(const std::vector<NodeAddr> &nodes) const {
+        std::vector<NodeAddr> result;
+        size_t others = 0;
+        for (NodeAddr node : nodes) {
+          others += m_priority.count(node) ? 0 : 1;
+        }
+        const size_t step = std::max<size_t>(1, m_config.sample == 0 ? others + 1 : others / m_config.sample);
+        size_t i = 0;
+        for (NodeAddr node : nodes) {
+          if (m_priority.count(node) || (m_config.sample != 0 && i++ % step == 0)) {
+            result.push_back(node);
+          }
+        }
+        return result;
+      }
+
+      Measurement & measurement(NodeAddr node, clock::time_point now, const GetTimeAndDateCmd::data_recv_t &t) {
+        auto device = DateTimeBase::convertToTimePoint(t, m_config.tz);
+        Measurement &m = m_measurements[node];
+        m.node = node;
+        m.offset = std::chrono::duration_cast<std::chrono::seconds>(device - std::chrono::time_point_cast<std::chrono::seconds>(now));
+        auto it = m_synced.find(node);
+        m.since_sync = it == m_synced.end() ? std::chrono::seconds(0) : std::chrono::duration_cast<std::chrono::seconds>(now - it->second);
+        return m;
+      }
+
+    private:
+      Transport &m_transport;
+      Config m_config;
+      Broadcast::Config m_broadcast_config;
+      // lead of the commit time, grows when preset phase ends after the commit time
+      std::chrono::milliseconds m_lead;
+      std::vector<NodeAddr> m_nodes;
+      std::unordered_set<NodeAddr> m_known;
+      std::set<NodeAddr> m_priority;
+      std::unordered_map<NodeAddr, clock::time_point> m_synced;
+      std::unordered_map<NodeAddr, Measurement> m_measurements;
+      std::vector<NodeAddr> m_resync;
+      Stats m_stats;
+  };
+}
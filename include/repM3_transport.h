@@ -0,0 +1,40 @@
+#pragma once
+
+#include <repM3.h>
+
+namespace lgmc {
+
+  /* pluggable asynchronous transport between the gateway and RepM3 nodes
+   * requests are queued by send(), responses are delivered by receive() to the receiver
+   */
+  class Transport {
+    public:
+      // gets response frames from the transport
+      class Receiver {
+        public:
+          virtual ~Receiver() {}
+          virtual void onFrame(NodeAddr node, const uint8_t *data, size_t size) = 0;
+      };
+
+      virtual ~Transport() {}
+
+      // queue request frame for the node, returns false when the frame can't be sent now
+      virtual bool send(NodeAddr node, const uint8_t *data, size_t size) = 0;
+
+      /* queue one request frame for many nodes, transport with mesh broadcast (FRC) sends it once
+       * returns number of nodes from the beginning of the list the frame was queued for
+       */
+      virtual size_t broadcast(const NodeAddr *nodes, size_t count, const uint8_t *data, size_t size) {
+        size_t n = 0;
+        while (n < count && send(nodes[n], data, size)) {
+          n++;
+        }
+        return n;
+      }
+
+      /* deliver received frames to the receiver, waits at most timeout for the first frame
+       * returns number of delivered frames
+       */
+      virtual size_t receive(Receiver &receiver, std::chrono::microseconds timeout) = 0;
+  };
+}